@@ -1,15 +1,47 @@
+#ifdef COMPRESSOR_TEST
+#undef NDEBUG
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
-#include <cmath>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
-#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-using HistoryEntry = std::unordered_map<std::string, std::size_t>;
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 enum Model
 {
@@ -22,9 +54,27 @@ enum Model
 enum Action
 {
     Compress,
-    Decompress
+    Decompress,
+    Learn
+};
+
+enum ModelSet
+{
+    Full,
+    Lean,
+    Fast
 };
 
+struct PresetLevels
+{
+    ModelSet modelSet = ModelSet::Full;
+    std::size_t statisticsLevels = 1;
+    std::size_t historicLevels = 1;
+    std::size_t tableShift = 2;
+    std::size_t runMinimumMatch = 0;
+};
+
+#if defined(COMPRESSOR_TEST) || defined(COMPRESSOR_BENCHMARK)
 struct RelativePosition
 {
     std::size_t inputPosition = 0;
@@ -38,6 +88,7 @@ struct RelativePosition
         this->level = level;
     }
 };
+#endif
 
 struct CombinationData
 {
@@ -53,19 +104,215 @@ struct CombinationData
     }
 };
 
-bool CheckDoubles(double first, double second)
+constexpr std::int32_t probabilityBits = 12;
+constexpr std::int32_t probabilityScale = 1 << probabilityBits;
+constexpr std::int32_t stretchLimit = 2047;
+constexpr std::size_t reciprocalSize = 1024;
+constexpr std::size_t bucketSlots = 4;
+constexpr std::size_t nibbleBits = 4;
+constexpr std::size_t nibbleNodes = (1 << nibbleBits) - 1;
+constexpr std::size_t stateCount = 256;
+constexpr std::size_t stateMapRows = 8;
+constexpr std::size_t votingRows = 16;
+constexpr std::uint8_t stateCountLimit = 30;
+constexpr std::uint16_t stateAdaptLimit = 127;
+constexpr std::uint16_t performanceAdaptLimit = 255;
+constexpr std::size_t modelCount = 4;
+constexpr std::size_t presetCount = 9;
+constexpr std::size_t defaultPreset = 6;
+constexpr std::size_t mapBuckets = 33;
+constexpr std::size_t mapCount = 3;
+constexpr std::uint16_t mapAdaptLimit = 30;
+constexpr std::size_t runLengthBits = 7;
+constexpr std::size_t frameVotes = 8;
+constexpr std::size_t ringFrames = 1 << 12;
+constexpr std::size_t minimumMemoryBits = 20;
+constexpr std::size_t maximumMemoryBits = 40;
+constexpr std::uint64_t hashMultiplier = 0x9E3779B97F4A7C15;
+constexpr std::size_t matchMinimum = 6;
+constexpr std::int32_t bucketWidth = 128;
+constexpr std::size_t dictionaryPrefix = 4;
+constexpr std::size_t entryLength = 32;
+
+constexpr std::array<PresetLevels, presetCount> presetTable{{
+    {ModelSet::Fast, 1, 1, 4, 16},
+    {ModelSet::Fast, 8, 1, 4, 16},
+    {ModelSet::Lean, 1, 8, 3, 24},
+    {ModelSet::Full, 1, 8, 3, 32},
+    {ModelSet::Lean, 2, 16, 2, 48},
+    {ModelSet::Full, 2, 16, 2, 64},
+    {ModelSet::Full, 8, 16, 2, 128},
+    {ModelSet::Full, 2, 24, 2, 0},
+    {ModelSet::Full, 8, 24, 2, 0}}};
+
+constexpr std::int32_t InterpolateSquash(std::int32_t stretched)
+{
+    constexpr std::int32_t points[33] = {
+        1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101, 1546, 2047,
+        2549, 2994, 3348, 3607, 3785, 3901, 3975, 4022, 4050, 4068, 4079, 4085, 4089, 4092, 4093, 4094};
+
+    if (stretched > stretchLimit)
+    {
+        return probabilityScale - 1;
+    }
+
+    if (stretched < -stretchLimit)
+    {
+        return 1;
+    }
+
+    const std::int32_t weight = stretched & 127;
+    const std::int32_t index = (stretched >> 7) + 16;
+
+    return (points[index] * (128 - weight) + points[index + 1] * weight + 64) >> 7;
+}
+
+constexpr std::array<std::int16_t, 2 * stretchLimit + 1> BuildSquashTable()
+{
+    std::array<std::int16_t, 2 * stretchLimit + 1> squashTable{};
+
+    for (std::int32_t stretched = -stretchLimit; stretched <= stretchLimit; stretched++)
+    {
+        squashTable[stretched + stretchLimit] = static_cast<std::int16_t>(InterpolateSquash(stretched));
+    }
+
+    return squashTable;
+}
+
+constexpr std::array<std::int16_t, probabilityScale> BuildStretchTable()
+{
+    std::array<std::int16_t, probabilityScale> stretchTable{};
+    std::int32_t probability = 0;
+
+    for (std::int32_t stretched = -stretchLimit; stretched <= stretchLimit; stretched++)
+    {
+        const std::int32_t squashed = InterpolateSquash(stretched);
+
+        for (; probability <= squashed; probability++)
+        {
+            stretchTable[probability] = static_cast<std::int16_t>(stretched);
+        }
+    }
+
+    for (; probability < probabilityScale; probability++)
+    {
+        stretchTable[probability] = static_cast<std::int16_t>(stretchLimit);
+    }
+
+    return stretchTable;
+}
+
+constexpr std::array<std::uint32_t, reciprocalSize> BuildReciprocalTable()
+{
+    std::array<std::uint32_t, reciprocalSize> reciprocalTable{};
+
+    for (std::size_t denominator = 1; denominator < reciprocalSize; denominator++)
+    {
+        reciprocalTable[denominator] = static_cast<std::uint32_t>((static_cast<std::uint64_t>(1) << 28) / denominator);
+    }
+
+    return reciprocalTable;
+}
+
+struct BitState
+{
+    std::uint8_t zeros = 0;
+    std::uint8_t ones = 0;
+    std::array<std::uint8_t, 2> next{};
+};
+
+constexpr BitState NextCounts(const BitState& bitState, unsigned char bit)
+{
+    BitState nextState;
+    std::uint8_t& seen = bit == 0 ? nextState.zeros : nextState.ones;
+    std::uint8_t& opposite = bit == 0 ? nextState.ones : nextState.zeros;
+
+    nextState.zeros = bitState.zeros;
+    nextState.ones = bitState.ones;
+    seen = std::min<std::uint8_t>(seen + 1, stateCountLimit);
+
+    if (opposite > 2)
+    {
+        opposite = opposite / 2 + 1;
+    }
+
+    return nextState;
+}
+
+constexpr std::array<BitState, stateCount> BuildStateTable()
+{
+    std::array<BitState, stateCount> stateTable{};
+    std::size_t stateTotal = 1;
+
+    for (std::size_t state = 0; state < stateTotal; state++)
+    {
+        for (unsigned char bit = 0; bit < 2; bit++)
+        {
+            const BitState nextCounts = NextCounts(stateTable[state], bit);
+            std::size_t nextState = 0;
+
+            while (nextState < stateTotal &&
+                (stateTable[nextState].zeros != nextCounts.zeros || stateTable[nextState].ones != nextCounts.ones))
+            {
+                nextState++;
+            }
+
+            if (nextState == stateTotal)
+            {
+                stateTable[stateTotal++] = nextCounts;
+            }
+
+            stateTable[state].next[bit] = static_cast<std::uint8_t>(nextState);
+        }
+    }
+
+    return stateTable;
+}
+
+constexpr std::array<BitState, stateCount> stateTable = BuildStateTable();
+constexpr std::array<std::int16_t, 2 * stretchLimit + 1> squashTable = BuildSquashTable();
+constexpr std::array<std::int16_t, probabilityScale> stretchTable = BuildStretchTable();
+constexpr std::array<std::uint32_t, reciprocalSize> reciprocalTable = BuildReciprocalTable();
+
+std::int32_t Squash(std::int32_t stretched)
+{
+    return squashTable[std::min(std::max(stretched, -stretchLimit), stretchLimit) + stretchLimit];
+}
+
+std::int32_t Stretch(std::int32_t probability)
+{
+    return stretchTable[std::min(std::max(probability, 0), probabilityScale - 1)];
+}
+
+std::uint16_t StateProbability(std::uint8_t state)
 {
-    return std::fabs(first - second) < 0.01;
+    const std::uint64_t zeros = stateTable[state].zeros;
+    const std::uint64_t ones = stateTable[state].ones;
+
+    return static_cast<std::uint16_t>((ones * 2 + 1) * probabilityScale / ((zeros + ones) * 2 + 2));
+}
+
+void Adapt(std::uint16_t& probability, std::uint16_t& count, unsigned char bit, std::uint16_t limit)
+{
+    const std::int64_t target = bit == 1 ? probabilityScale - 1 : 0;
+    const std::int64_t delta = target - probability;
+
+    probability = static_cast<std::uint16_t>(probability + ((delta * reciprocalTable[count + 1]) >> 28));
+
+    if (count < limit)
+    {
+        count++;
+    }
 }
 
 struct VoteWeight
 {
-    double confidence = 0.0;
-    double performance = 0.0;
+    std::uint16_t confidence = 0;
+    std::uint16_t performance = 0;
 
     bool operator==(const VoteWeight& otherWeight) const
     {
-        return CheckDoubles(confidence, otherWeight.confidence) && CheckDoubles(performance, otherWeight.performance);
+        return confidence == otherWeight.confidence && performance == otherWeight.performance;
     }
 };
 
@@ -76,7 +323,7 @@ struct Vote
 
     Vote() = default;
 
-    Vote(unsigned char bit, double confidence, double performance)
+    Vote(unsigned char bit, std::uint16_t confidence, std::uint16_t performance)
     {
         this->bit = bit;
         this->voteWeight.confidence = confidence;
@@ -92,39 +339,130 @@ struct Vote
 struct Guess
 {
     unsigned char bit = 1;
-    double confidence = 0.5;
+    std::uint16_t confidence = probabilityScale / 2;
+    std::vector<Vote> statisticsVotes;
+    std::vector<Vote> historicVotes;
+    std::vector<Vote> distanceVotes;
+    std::vector<Vote> futureVotes;
+    std::vector<std::int16_t> mixerInputs;
+    std::size_t mixerContext = 0;
+    std::uint16_t mixerProbability = probabilityScale / 2;
+    std::array<std::size_t, mapCount> mapCells{};
+    std::int32_t mapWeight = 0;
+};
+
+struct RunGuess
+{
+    std::uint64_t bits = 0;
+    std::size_t length = 0;
+};
+
+struct VoteFrame
+{
+    std::array<Vote, frameVotes> statisticsVotes;
+    std::array<Vote, frameVotes> historicVotes;
+    std::uint8_t statisticsCount = 0;
+    std::uint8_t historicCount = 0;
+};
+
+struct VoteRing
+{
+    std::vector<VoteFrame> frames = std::vector<VoteFrame>(ringFrames);
+    alignas(64) std::atomic<std::size_t> written{0};
+    std::size_t readSeen = 0;
+    alignas(64) std::atomic<std::size_t> read{0};
+    std::size_t writtenSeen = 0;
+    alignas(64) std::atomic<bool> stopped{false};
+    std::exception_ptr failure;
 };
 
 struct Performance
 {
-    std::size_t correct = 0;
-    std::size_t incorrect = 1;
+    std::uint16_t accuracy = probabilityScale / 2;
+    std::uint16_t count = 0;
+};
 
-    Performance() = default;
+struct AdaptiveProbability
+{
+    std::uint16_t probability = probabilityScale / 2;
+    std::uint16_t count = 0;
+};
 
-    Performance(std::size_t correct, std::size_t incorrect)
-    {
-        this->correct = correct;
-        this->incorrect = incorrect;
-    }
+struct ContextSlot
+{
+    std::uint8_t check = 0;
+    std::array<std::uint8_t, nibbleNodes> states{};
+};
+
+struct alignas(64) ContextBucket
+{
+    std::array<ContextSlot, bucketSlots> slots;
+};
+
+struct ContextTable
+{
+    std::vector<ContextBucket> ownedBuckets = std::vector<ContextBucket>(2);
+    std::span<ContextBucket> buckets = ownedBuckets;
+    std::size_t used = 0;
+    std::size_t evictions = 0;
+
+    ContextTable() = default;
+    ContextTable(const ContextTable&) = delete;
+    ContextTable& operator=(const ContextTable&) = delete;
+    ContextTable(ContextTable&&) = default;
+    ContextTable& operator=(ContextTable&&) = default;
+};
+
+struct MatchHistory
+{
+    std::vector<std::uint32_t> positions;
+    std::size_t matchPointer = 0;
+    std::size_t matchLength = 0;
+    std::vector<Performance> lengthPerformance = std::vector<Performance>(64);
+};
+
+struct DictionaryHistory
+{
+    std::vector<std::vector<unsigned char>> entries;
+    std::vector<std::uint32_t> index;
+    std::size_t activeEntry = 0;
+    std::size_t entryOffset = 0;
+    std::vector<Performance> offsetPerformance = std::vector<Performance>(64);
 };
 
 struct History
 {
-    std::unordered_map<std::string, HistoryEntry> historicData;
-    std::unordered_map<std::size_t, Performance> performance;
+    ContextTable historicData;
+    std::vector<std::size_t> activeSlots;
+    std::uint64_t activeNibble = std::numeric_limits<std::uint64_t>::max();
+    std::vector<AdaptiveProbability> stateMap;
+    std::array<Performance, votingRows> performance{};
+    MatchHistory match;
+    DictionaryHistory dictionary;
 };
 
 struct PredictionModel
 {
     Model model = Model::Statistics;
     std::size_t levels = 1;
+    bool active = false;
     History history;
+    mutable std::chrono::steady_clock::duration elapsed{};
 
     PredictionModel() = default;
     PredictionModel(Model model, std::size_t levels = 1)
     {
         this->model = model;
+        this->levels = levels;
+        this->active = true;
+
+        for (std::size_t row = 0; row < stateMapRows; row++)
+        {
+            for (std::size_t state = 0; state < stateCount; state++)
+            {
+                history.stateMap.push_back(AdaptiveProbability{StateProbability(static_cast<std::uint8_t>(state)), 0});
+            }
+        }
     }
 };
 
@@ -132,16 +470,163 @@ struct GuessResult
 {
     bool correct = true;
     std::vector<unsigned char> guessedBits{1};
+    Guess guess;
+};
+
+struct ArchiveHeader
+{
+    std::uint8_t version = 10;
+    std::uint64_t originalSize = 0;
+    std::uint8_t memoryBits = 28;
+    std::uint8_t preset = defaultPreset;
+    std::uint64_t snapshotIdentity = 0;
+    std::vector<std::vector<unsigned char>> dictionary;
+};
+
+struct SnapshotSection
+{
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+};
+
+struct SnapshotModel
+{
+    SnapshotSection table;
+    SnapshotSection stateMap;
+    SnapshotSection performance;
+    SnapshotSection bucketPerformance;
+    std::uint64_t used = 0;
+    std::uint64_t evictions = 0;
+};
+
+struct SnapshotHeader
+{
+    std::array<unsigned char, 4> magic{'I', 'W', 'S', 0};
+    std::uint32_t version = 3;
+    std::uint64_t identity = 0;
+    std::uint64_t memoryBits = ArchiveHeader().memoryBits;
+    std::uint64_t preset = defaultPreset;
+    std::array<SnapshotModel, modelCount> models{};
+    SnapshotSection mixerWeights;
+    std::array<SnapshotSection, mapCount> probabilityMaps{};
+    SnapshotSection runLengths;
+};
+
+struct BlockEntry
+{
+    std::uint64_t originalSize = 0;
+    std::uint64_t compressedSize = 0;
+};
+
+struct ContainerHeader
+{
+    std::uint8_t version = 3;
+    std::uint64_t originalSize = 0;
+    std::vector<BlockEntry> blocks;
+};
+
+struct WorkQueue
+{
+    std::mutex mutex;
+    std::deque<std::size_t> tasks;
+};
+
+struct DictionaryCandidate
+{
+    std::size_t count = 0;
+    std::size_t position = 0;
+};
+
+constexpr std::size_t candidateRows = 2;
+
+struct CandidateCounts
+{
+    std::size_t slots = 0;
+    std::vector<std::atomic<std::uint32_t>> counts;
+    std::vector<std::atomic<std::uint64_t>> firstPositions;
+
+    explicit CandidateCounts(std::size_t slots) : slots(slots), counts(slots * candidateRows), firstPositions(slots * candidateRows)
+    {
+    }
+};
+
+struct ByteSink
+{
+    std::ofstream outputFile;
+    std::vector<unsigned char>* memory = nullptr;
+    bool discard = false;
+    std::vector<unsigned char> buffer = std::vector<unsigned char>(1 << 16);
+    std::size_t used = 0;
+    std::size_t written = 0;
+};
+
+struct ByteSource
+{
+    std::ifstream inputFile;
+    std::vector<unsigned char> buffer = std::vector<unsigned char>(1 << 16);
+    std::size_t position = 0;
+    std::size_t available = 0;
+    std::size_t overrun = 0;
+    std::uint64_t remaining = std::numeric_limits<std::uint64_t>::max();
+};
+
+struct ArithmeticEncoder
+{
+    std::uint32_t low = 0;
+    std::uint32_t high = 0xFFFFFFFF;
+};
+
+struct ArithmeticDecoder
+{
+    std::uint32_t low = 0;
+    std::uint32_t high = 0xFFFFFFFF;
+    std::uint32_t code = 0;
+};
+
+struct CodingReport
+{
+    std::size_t inputSize = 0;
+    std::size_t outputSize = 0;
+    std::size_t correctBits = 0;
+    std::size_t dictionaryEntries = 0;
+    double dictionarySeconds = 0.0;
+    std::vector<std::pair<std::string, double>> modelSeconds;
+};
+
+struct ByteRange
+{
+    std::uint64_t start = 0;
+    std::uint64_t length = std::numeric_limits<std::uint64_t>::max();
+
+    bool operator==(const ByteRange& otherRange) const
+    {
+        return start == otherRange.start && length == otherRange.length;
+    }
 };
 
 struct Command
 {
     Action action = Action::Compress;
     std::string target = "enwik1";
+    std::size_t jobs = 1;
+    std::size_t blockSize = 0;
+    std::uint64_t memory = static_cast<std::uint64_t>(1) << ArchiveHeader().memoryBits;
+    bool explicitMemory = false;
+    bool prefetch = true;
+    std::size_t preset = defaultPreset;
+    bool explicitPreset = false;
+    std::size_t modelThreads = 1;
+    std::string snapshot;
+    bool force = false;
+    ByteRange range;
 
     bool operator==(const Command& otherCommand) const
     {
-        return action == otherCommand.action && target == otherCommand.target;
+        return action == otherCommand.action && target == otherCommand.target && jobs == otherCommand.jobs &&
+            blockSize == otherCommand.blockSize && memory == otherCommand.memory &&
+            explicitMemory == otherCommand.explicitMemory && prefetch == otherCommand.prefetch &&
+            preset == otherCommand.preset && explicitPreset == otherCommand.explicitPreset && modelThreads == otherCommand.modelThreads &&
+            snapshot == otherCommand.snapshot && force == otherCommand.force && range == otherCommand.range;
     }
 
     Command() = default;
@@ -152,10 +637,29 @@ struct Command
     }
 };
 
+struct InputBuffer
+{
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    std::vector<unsigned char> ownedBytes;
+
+    InputBuffer() = default;
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    ~InputBuffer()
+    {
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mappingSize);
+        }
+    }
+};
+
 struct Operation
 {
     Command command = Command(Action::Compress, "enwik1");
-    std::vector<unsigned char> inputBytes{'<', 'm', 'e', 'd', 'i', 'a', 'w', 'i', 'k', 'i'};
+    std::span<const unsigned char> inputBytes;
 };
 
 struct Position
@@ -170,642 +674,5299 @@ struct OperationStatus
     Position position;
 };
 
+struct BitHistory
+{
+    std::uint64_t recentBits = 0;
+    std::size_t length = 0;
+};
+
+struct ByteHistory
+{
+    std::vector<unsigned char> window;
+    std::size_t capacity = 1 << 24;
+    std::size_t length = 0;
+    std::uint32_t partialByte = 1;
+};
+
+struct Mixer
+{
+    std::size_t inputCount = 0;
+    std::size_t contexts = 0;
+    std::vector<std::int16_t> weights;
+    mutable std::chrono::steady_clock::duration elapsed{};
+};
+
+struct ProbabilityMap
+{
+    std::size_t contexts = 0;
+    std::vector<AdaptiveProbability> ownedCells;
+    std::span<AdaptiveProbability> cells = ownedCells;
+
+    ProbabilityMap() = default;
+    ProbabilityMap(const ProbabilityMap&) = delete;
+    ProbabilityMap& operator=(const ProbabilityMap&) = delete;
+    ProbabilityMap(ProbabilityMap&&) = default;
+    ProbabilityMap& operator=(ProbabilityMap&&) = default;
+};
+
 struct Predictor
 {
     OperationStatus operationStatus;
-    std::unordered_map<std::string, PredictionModel> predictionModels;
+    BitHistory bitHistory;
+    ByteHistory byteHistory;
+    Mixer mixer;
+    std::array<ProbabilityMap, mapCount> probabilityMaps;
+    std::array<AdaptiveProbability, 1 << runLengthBits> runLengths;
+    std::size_t runMinimumMatch = 0;
+    std::array<PredictionModel, modelCount> predictionModels;
+    std::shared_ptr<InputBuffer> snapshot;
+    bool prefetch = true;
 };
 
-std::string GenerateKey(const CombinationData& combinationData)
+template <Model... models>
+struct ModelPipeline
 {
-    std::string combinationKey = "";
+    static constexpr std::array<Model, sizeof...(models)> modelList{models...};
 
-    for (std::size_t position = 1; position <= combinationData.level; position++)
+    static constexpr bool Contains(Model model)
     {
-        if (combinationData.value & (1 << combinationData.level - position))
-        {
-            combinationKey += "1";
-        }
-        else
-        {
-            combinationKey += "0";
-        }
+        return ((model == models) || ...);
     }
 
-    return combinationKey;
-}
+    template <typename Function>
+    static void ForEach(Function&& function)
+    {
+        (function(std::integral_constant<Model, models>()), ...);
+    }
+};
 
-std::size_t BitPosition(const RelativePosition& relativePosition)
+using FullPipeline = ModelPipeline<Model::Statistics, Model::HistoricDictionary, Model::FutureDictionary, Model::Distance>;
+using LeanPipeline = ModelPipeline<Model::Statistics, Model::HistoricDictionary, Model::Distance>;
+using FastPipeline = ModelPipeline<Model::Statistics, Model::Distance>;
+
+template <typename Pipeline, Model... models>
+using RunPipeline = std::conditional_t<Pipeline::Contains(Model::FutureDictionary),
+    ModelPipeline<models..., Model::FutureDictionary, Model::Distance>, ModelPipeline<models..., Model::Distance>>;
+
+const PresetLevels& PresetFor(std::size_t preset)
 {
-    std::size_t bitPosition = relativePosition.level;
-    while ((relativePosition.inputPosition - (relativePosition.level - bitPosition)) % bitPosition != 0)
+    if (preset == 0 || preset > presetCount)
     {
-        bitPosition--;
+        throw std::runtime_error("Unknown preset " + std::to_string(preset));
     }
 
-    return relativePosition.level - bitPosition;
+    return presetTable[preset - 1];
 }
 
-unsigned char GetBitFromInput(const std::vector<unsigned char> inputBytes, std::size_t bitPosition)
+template <typename Function>
+decltype(auto) WithPipeline(std::size_t preset, Function&& function)
 {
-    return (inputBytes.at(bitPosition / 8) & (128 >> (bitPosition % 8))) > 0 ? 1 : 0;
+    switch (PresetFor(preset).modelSet)
+    {
+        case ModelSet::Full:
+            return function(FullPipeline());
+        case ModelSet::Lean:
+            return function(LeanPipeline());
+        case ModelSet::Fast:
+            return function(FastPipeline());
+        default:
+            throw std::runtime_error("Unknown model set");
+    }
 }
 
-bool StillPossible(
-    const Predictor& predictor,
-    const std::vector<unsigned char> guessedBits,
-    std::string combinationKey,
-    std::size_t bitPosition)
-{
-    assert(GetBitFromInput({0}, 0) == 0);
-    assert(GetBitFromInput({1}, 0) == 0);
-    assert(GetBitFromInput({128}, 0) == 1);
-    assert(GetBitFromInput({128, 0}, 0) == 1);
-    assert(GetBitFromInput({128, 0}, 1) == 0);
-    assert(GetBitFromInput({128, 0}, 9) == 0);
-    assert(GetBitFromInput({255, 0}, 7) == 1);
-    assert(GetBitFromInput({128, 255}, 9) == 1);
-    assert(GetBitFromInput({128, 64, 2, 0}, 23) == 0);
-    assert(GetBitFromInput({128, 64, 2, 0}, 22) == 1);
-
-    const std::vector<unsigned char>& inputBytes = predictor.operationStatus.operation.inputBytes;
-    const std::size_t inputPosition = predictor.operationStatus.position.inputPosition;
+std::chrono::steady_clock::time_point StartModelClock()
+{
+#ifdef COMPRESSOR_BENCHMARK
+    return std::chrono::steady_clock::now();
+#else
+    return std::chrono::steady_clock::time_point();
+#endif
+}
+
+void StopModelClock(std::chrono::steady_clock::duration& elapsed, std::chrono::steady_clock::time_point start)
+{
+#ifdef COMPRESSOR_BENCHMARK
+    elapsed += std::chrono::steady_clock::now() - start;
+#else
+    static_cast<void>(elapsed);
+    static_cast<void>(start);
+#endif
+}
 
-    for (std::size_t i = bitPosition; i > 0; i--)
+std::string ModelName(Model model)
+{
+    switch (model)
     {
-        if (guessedBits.size() >= ((bitPosition - i) + 1))
-        {
-            if (guessedBits.at(guessedBits.size() - ((bitPosition - i) + 1)) !=
-                (combinationKey.at(bitPosition - ((bitPosition - i) + 1)) == '0' ? 0 : 1))
-            {
-                return false;
-            }
-        }
-        else
-        {
-            if (GetBitFromInput(inputBytes, inputPosition - (((bitPosition - guessedBits.size()) - i) + 1)) !=
-                (combinationKey.at(bitPosition - ((bitPosition - i) + 1)) == '0' ? 0 : 1))
-            {
-                return false;
-            }
-        }
+        case Model::Statistics:
+            return "Statistics";
+        case Model::HistoricDictionary:
+            return "HistoricDictionary";
+        case Model::FutureDictionary:
+            return "FutureDictionary";
+        case Model::Distance:
+            return "Distance";
+        default:
+            throw std::runtime_error("Unknown prediction model");
     }
-
-    return true;
 }
 
-std::string GenerateHistoricKey(const Predictor& predictor, std::vector<unsigned char> guessedBits, std::size_t level)
+std::vector<std::pair<std::string, double>> ModelSeconds(const Predictor& predictor)
 {
-    const std::vector<unsigned char>& inputBytes = predictor.operationStatus.operation.inputBytes;
-    const std::size_t inputPosition = predictor.operationStatus.position.inputPosition;
+    std::vector<std::pair<std::string, double>> modelSeconds;
 
-    std::string key;
-
-    for (std::size_t i = level; i > 0; i--)
+    for (const PredictionModel& predictionModel: predictor.predictionModels)
     {
-        if (guessedBits.size() >= ((level - i) + 1))
+        if (predictionModel.active)
         {
-            key.insert(0, (guessedBits.at(guessedBits.size() - ((level - i) + 1)) == 0 ? "0" : "1"));
-        }
-        else
-        {
-            key.insert(0, (GetBitFromInput(inputBytes, inputPosition - (((level - guessedBits.size()) - i) + 1)) == 0 ? "0" : "1"));
+            modelSeconds.emplace_back(ModelName(predictionModel.model), std::chrono::duration<double>(predictionModel.elapsed).count());
         }
     }
 
-    return key;
+    std::sort(modelSeconds.begin(), modelSeconds.end());
+    modelSeconds.emplace_back("Mixer", std::chrono::duration<double>(predictor.mixer.elapsed).count());
+
+    return modelSeconds;
 }
 
-std::vector<Vote> StatisticsVotes(const Predictor& predictor, const std::vector<unsigned char> guessedBits)
+std::uint64_t PackContext(std::size_t level, std::uint64_t pattern)
 {
-    assert(GenerateKey(CombinationData(1, 0)) == "0");
-    assert(GenerateKey(CombinationData(1, 1)) == "1");
-    assert(GenerateKey(CombinationData(2, 0)) == "00");
-    assert(GenerateKey(CombinationData(2, 2)) == "10");
-    assert(GenerateKey(CombinationData(2, 3)) == "11");
-    assert(GenerateKey(CombinationData(4, 5)) == "0101");
-    assert(GenerateKey(CombinationData(8, 42)) == "00101010");
-    assert(GenerateKey(CombinationData(16, 127)) == "0000000001111111");
+    const std::size_t patternBits = 56;
+    const std::uint64_t patternMask = (static_cast<std::uint64_t>(1) << patternBits) - 1;
 
-    assert(BitPosition(RelativePosition(0, 1)) == 0);
-    assert(BitPosition(RelativePosition(1, 1)) == 0);
-    assert(BitPosition(RelativePosition(1, 2)) == 1);
-    assert(BitPosition(RelativePosition(2, 1)) == 0);
-    assert(BitPosition(RelativePosition(2, 2)) == 0);
-    assert(BitPosition(RelativePosition(3, 1)) == 0);
-    assert(BitPosition(RelativePosition(3, 2)) == 1);
-    assert(BitPosition(RelativePosition(4, 4)) == 0);
-    assert(BitPosition(RelativePosition(30, 4)) == 2);
+    if (level == 0 || level >= 256)
+    {
+        throw std::runtime_error("Context level " + std::to_string(level) + " cannot be packed");
+    }
 
-    Predictor testPredictor;
-    assert(StillPossible(testPredictor, {}, "0", 0) == true);
-    assert(StillPossible(testPredictor, {1}, "01", 0) == true);
-    assert(StillPossible(testPredictor, {1}, "01", 1) == false);
-    assert(StillPossible(testPredictor, {1}, "11", 1) == true);
+    return (static_cast<std::uint64_t>(level) << patternBits) | (pattern & patternMask);
+}
 
-    testPredictor.operationStatus.operation.inputBytes = {128};
-    testPredictor.operationStatus.position.inputPosition = 1;
-    assert(StillPossible(testPredictor, {}, "11", 1) == true);
+std::uint64_t GenerateKey(const CombinationData& combinationData)
+{
+    const std::uint64_t levelMask = combinationData.level >= 64 ? ~static_cast<std::uint64_t>(0) :
+        (static_cast<std::uint64_t>(1) << combinationData.level) - 1;
 
-    testPredictor.operationStatus.operation.inputBytes = {128, 64, 0, 255};
-    testPredictor.operationStatus.position.inputPosition = 31;
-    assert(StillPossible(testPredictor, {1, 1, 1}, "111111", 5) == true);
+    return PackContext(combinationData.level, combinationData.value & levelMask);
+}
 
-    testPredictor.operationStatus.operation.inputBytes = {128, 64, 0, 0};
-    testPredictor.operationStatus.position.inputPosition = 31;
-    assert(StillPossible(testPredictor, {1, 1, 1}, "111111", 5) == false);
+std::uint64_t GenerateEntryKey(const CombinationData& contextData, std::uint64_t combination)
+{
+    const std::size_t maximumLevel = 28;
 
-    testPredictor.operationStatus.operation.inputBytes = {128, 64, 1, 0};
-    testPredictor.operationStatus.position.inputPosition = 25;
-    assert(StillPossible(testPredictor, {0, 0, 0}, "00000", 5) == false);
+    if (contextData.level > maximumLevel)
+    {
+        throw std::runtime_error("Historic level " + std::to_string(contextData.level) + " is too large");
+    }
 
-    testPredictor.operationStatus.operation.inputBytes = {128, 64, 2, 0};
-    testPredictor.operationStatus.position.inputPosition = 25;
-    assert(StillPossible(testPredictor, {0, 0, 0}, "00000", 5) == true);
+    return GenerateKey(CombinationData(contextData.level * 2, (contextData.value << contextData.level) | combination));
+}
 
-    std::vector<Vote> votes;
-    const PredictionModel& statisticsModel = predictor.predictionModels.at("Statistics");
-    const std::unordered_map<std::string, HistoryEntry> historicData = statisticsModel.history.historicData;
-    std::size_t divisor = 1;
+std::uint64_t GeneratePartialKey(std::size_t level, const CombinationData& prefixData)
+{
+    const std::uint64_t prefixMask = (static_cast<std::uint64_t>(1) << prefixData.level) - 1;
 
-    for (std::size_t level = 1; level <= statisticsModel.levels; level++)
+    if (prefixData.level > level)
     {
-        if (level % divisor != 0)
-        {
-            continue;
-        }
-        else
-        {
-            if (divisor < 8)
-            {
-                divisor *= 2;
-            }
-        }
+        throw std::runtime_error("Partial context is longer than level " + std::to_string(level));
+    }
 
-        std::size_t votesZero = 0;
-        std::size_t votesOne = 0;
+    return PackContext(level, (static_cast<std::uint64_t>(1) << prefixData.level) | (prefixData.value & prefixMask));
+}
 
-        for (std::size_t combination = 0; combination < 1 << level; combination++)
-        {
-            CombinationData combinationData;
-            combinationData.level = level;
-            combinationData.value = combination;
+std::uint64_t ContextHash(std::uint64_t key)
+{
+    const std::uint64_t hash = key * hashMultiplier;
+
+    return hash ^ (hash >> 29);
+}
 
-            std::string combinationKey = GenerateKey(combinationData);
+std::uint8_t ContextCheck(std::uint64_t hash)
+{
+    return std::max<std::uint8_t>(1, static_cast<std::uint8_t>(hash >> 56));
+}
 
-            if (statisticsModel.history.historicData.contains(combinationKey))
-            {
-                const HistoryEntry& combinationHistory = historicData.at(combinationKey);
+std::size_t BucketIndex(const ContextTable& contextTable, std::uint64_t hash)
+{
+    return static_cast<std::size_t>(hash) & (contextTable.buckets.size() - 1);
+}
 
-                RelativePosition relativePosition;
-                relativePosition.inputPosition = predictor.operationStatus.position.virtualPosition;
-                relativePosition.level = level;
+void InitializeContextTable(ContextTable& contextTable, std::size_t slotCount)
+{
+    contextTable.ownedBuckets.assign(std::max<std::size_t>(std::bit_floor(slotCount) / bucketSlots, 1), ContextBucket());
+    contextTable.buckets = contextTable.ownedBuckets;
+    contextTable.used = 0;
+    contextTable.evictions = 0;
+}
 
-                std::size_t bitPosition = BitPosition(relativePosition);
+ContextSlot& TableSlot(ContextTable& contextTable, std::size_t slotIndex)
+{
+    return contextTable.buckets[slotIndex / bucketSlots].slots[slotIndex % bucketSlots];
+}
 
-                if (StillPossible(predictor, guessedBits, combinationKey, bitPosition))
-                {
-                    if (combinationKey.at(bitPosition) == '0')
-                    {
-                        votesZero += combinationHistory.at("");
-                    }
-                    else
-                    {
-                        votesOne += combinationHistory.at("");
-                    }
-                }
-            }
-        }
+const ContextSlot& TableSlot(const ContextTable& contextTable, std::size_t slotIndex)
+{
+    return contextTable.buckets[slotIndex / bucketSlots].slots[slotIndex % bucketSlots];
+}
 
-        Performance performance;
+const ContextSlot* FindContext(const ContextTable& contextTable, std::uint64_t key)
+{
+    const std::uint64_t hash = ContextHash(key);
+    const std::uint8_t check = ContextCheck(hash);
+    const ContextBucket& bucket = contextTable.buckets[BucketIndex(contextTable, hash)];
 
-        if (statisticsModel.history.performance.contains(level))
+    for (const ContextSlot& slot: bucket.slots)
+    {
+        if (slot.check == check)
         {
-            performance = statisticsModel.history.performance.at(level);
+            return &slot;
         }
-
-        double votesZeroDouble = static_cast<double>(votesZero);
-        double votesOneDouble = static_cast<double>(votesOne);
-        double totalVotes = votesZeroDouble + votesOneDouble;
-
-        double correctDouble = static_cast<double>(performance.correct);
-        double incorrectDouble = static_cast<double>(performance.incorrect);
-        double totalGuesses = correctDouble + incorrectDouble;
-
-        totalVotes = totalVotes == 0 ? 1 : totalVotes;
-
-        VoteWeight voteWeight;
-        voteWeight.confidence = votesZero >= votesOne ? votesZeroDouble / totalVotes : votesOneDouble / totalVotes;
-        voteWeight.performance = correctDouble / (correctDouble + incorrectDouble);
-
-        Vote vote;
-        vote.bit = votesZero >= votesOne ? 0 : 1;
-        vote.voteWeight = voteWeight;
-
-        votes.push_back(vote);
     }
 
-    return votes;
+    return nullptr;
 }
 
-std::vector<Vote> HistoricVotes(const Predictor& predictor, const std::vector<unsigned char> guessedBits)
+std::size_t StatePriority(std::uint8_t state)
 {
-    Predictor testPredictor;
-    testPredictor.operationStatus.position.inputPosition = 1;
-    testPredictor.operationStatus.position.virtualPosition = 1;
-    testPredictor.operationStatus.operation.inputBytes = {0};
-    assert(GenerateHistoricKey(testPredictor, {}, 1) == "0");
-
-    testPredictor.operationStatus.operation.inputBytes = {128};
-    assert(GenerateHistoricKey(testPredictor, {}, 1) == "1");
-
-    testPredictor.operationStatus.operation.inputBytes = {64};
-    assert(GenerateHistoricKey(testPredictor, {}, 1) == "0");
-
-    testPredictor.operationStatus.operation.inputBytes = {64};
-    testPredictor.operationStatus.position.virtualPosition = 2;
-    assert(GenerateHistoricKey(testPredictor, {1}, 1) == "1");
-
-    assert(GenerateHistoricKey(testPredictor, {1}, 2) == "01");
-
-    testPredictor.operationStatus.operation.inputBytes = {128};
-    testPredictor.operationStatus.position.inputPosition = 2;
-    testPredictor.operationStatus.position.virtualPosition = 4;
-    assert(GenerateHistoricKey(testPredictor, {1, 0}, 4) == "1010");
-
-    const std::size_t inputPosition = predictor.operationStatus.position.inputPosition;
-    const std::size_t virtualPosition = predictor.operationStatus.position.virtualPosition;
-
-    const PredictionModel& historicModel = predictor.predictionModels.at("HistoricDictionary");
-    const std::unordered_map<std::string, HistoryEntry> historicData = historicModel.history.historicData;
+    return static_cast<std::size_t>(stateTable[state].zeros) + stateTable[state].ones;
+}
 
-    std::vector<Vote> votes;
-    std::size_t divisor = 1;
+std::size_t ContextIndex(ContextTable& contextTable, std::uint64_t key)
+{
+    const std::uint64_t hash = ContextHash(key);
+    const std::uint8_t check = ContextCheck(hash);
+    const std::size_t bucketIndex = BucketIndex(contextTable, hash);
+    ContextBucket& bucket = contextTable.buckets[bucketIndex];
+    std::size_t victim = 0;
 
-    for (std::size_t level = 1; level <= historicModel.levels; level++)
+    for (std::size_t slot = 0; slot < bucketSlots; slot++)
     {
-        if (virtualPosition < level)
-        {
-            break;
-        }
-
-        if (level % divisor != 0)
-        {
-            continue;
-        }
-        else
+        if (bucket.slots[slot].check == check)
         {
-            if (divisor < 8)
-            {
-                divisor *= 2;
-            }
+            return bucketIndex * bucketSlots + slot;
         }
 
-        std::size_t votesZero = 0;
-        std::size_t votesOne = 0;
-
-        std::string key = GenerateHistoricKey(predictor, guessedBits, level);
-
-        if (historicData.contains(key))
+        if (bucket.slots[slot].check == 0)
         {
-            HistoryEntry historyEntry = historicData.at(key);
-
-            for (auto& [combination, occurences]: historyEntry)
-            {
-                RelativePosition relativePosition;
-                relativePosition.inputPosition = predictor.operationStatus.position.virtualPosition;
-                relativePosition.level = level;
-
-                std::size_t bitPosition = BitPosition(relativePosition);
+            contextTable.used++;
+            bucket.slots[slot].check = check;
 
-                if (StillPossible(predictor, guessedBits, combination, bitPosition))
-                {
-                    if (combination.at(bitPosition) == '0')
-                    {
-                        votesZero += occurences;
-                    }
-                    else
-                    {
-                        votesOne += occurences;
-                    }
-                }
-            }
+            return bucketIndex * bucketSlots + slot;
         }
 
-        Performance performance;
-
-        if (historicModel.history.performance.contains(level))
+        if (StatePriority(bucket.slots[slot].states[0]) < StatePriority(bucket.slots[victim].states[0]))
         {
-            performance = historicModel.history.performance.at(level);
+            victim = slot;
         }
+    }
 
-        double votesZeroDouble = static_cast<double>(votesZero);
-        double votesOneDouble = static_cast<double>(votesOne);
-        double totalVotes = votesZeroDouble + votesOneDouble;
+    contextTable.evictions++;
+    bucket.slots[victim] = ContextSlot();
+    bucket.slots[victim].check = check;
 
-        double correctDouble = static_cast<double>(performance.correct);
-        double incorrectDouble = static_cast<double>(performance.incorrect);
-        double totalGuesses = correctDouble + incorrectDouble;
+    return bucketIndex * bucketSlots + victim;
+}
 
-        totalVotes = totalVotes == 0 ? 1 : totalVotes;
+ContextSlot& ContextState(ContextTable& contextTable, std::uint64_t key)
+{
+    return TableSlot(contextTable, ContextIndex(contextTable, key));
+}
 
-        VoteWeight voteWeight;
-        voteWeight.confidence = votesZero >= votesOne ? votesZeroDouble / totalVotes : votesOneDouble / totalVotes;
-        voteWeight.performance = correctDouble / (correctDouble + incorrectDouble);
+#if defined(COMPRESSOR_TEST) || defined(COMPRESSOR_BENCHMARK)
+std::size_t BitPosition(const RelativePosition& relativePosition)
+{
+    return relativePosition.inputPosition % relativePosition.level;
+}
+#endif
 
-        Vote vote;
-        vote.bit = votesZero >= votesOne ? 0 : 1;
-        vote.voteWeight = voteWeight;
+unsigned char GetBitFromInput(std::span<const unsigned char> inputBytes, std::size_t bitPosition)
+{
+    return (inputBytes[bitPosition / 8] & (128 >> (bitPosition % 8))) > 0 ? 1 : 0;
+}
 
-        votes.push_back(vote);
-    }
+std::uint64_t LowMask(std::size_t count)
+{
+    return count >= 64 ? ~static_cast<std::uint64_t>(0) : (static_cast<std::uint64_t>(1) << count) - 1;
+}
 
-    return votes;
+void PushBit(BitHistory& bitHistory, unsigned char bit)
+{
+    bitHistory.recentBits = (bitHistory.recentBits << 1) | bit;
+    bitHistory.length++;
 }
 
-Guess GuessBit(const Predictor& predictor, std::vector<unsigned char>& guessedBits)
+#if defined(COMPRESSOR_TEST) || defined(COMPRESSOR_BENCHMARK)
+void RebuildBitHistory(Predictor& predictor)
 {
-    Predictor testPredictor;
-    testPredictor.predictionModels["Statistics"] = PredictionModel(Model::Statistics);
-    testPredictor.predictionModels["HistoricDictionary"] = PredictionModel(Model::HistoricDictionary);
-    PredictionModel& statisticsModel = testPredictor.predictionModels["Statistics"];
-    PredictionModel& historicModel = testPredictor.predictionModels["HistoricDictionary"];
+    const std::span<const unsigned char> inputBytes = predictor.operationStatus.operation.inputBytes;
+    const std::size_t inputPosition = predictor.operationStatus.position.inputPosition;
+    const std::size_t registerBits = 64;
 
-    std::unordered_map<std::string, HistoryEntry>& statisticsHistory = statisticsModel.history.historicData;
-    std::unordered_map<std::size_t, Performance>& statisticsPerformance = statisticsModel.history.performance;
-    std::unordered_map<std::string, HistoryEntry>& historicHistory = historicModel.history.historicData;
-    std::unordered_map<std::size_t, Performance>& historicPerformance = historicModel.history.performance;
+    predictor.bitHistory = BitHistory();
+
+    for (std::size_t bitPosition = inputPosition > registerBits ? inputPosition - registerBits : 0;
+        bitPosition < inputPosition;
+        bitPosition++)
+    {
+        PushBit(predictor.bitHistory, GetBitFromInput(inputBytes, bitPosition));
+    }
 
-    statisticsHistory = std::unordered_map<std::string, HistoryEntry>();
-    statisticsPerformance = std::unordered_map<std::size_t, Performance>();
+    predictor.bitHistory.length = inputPosition;
+}
+#endif
 
-    std::vector<unsigned char> testGuessedBits;
+void PushByte(ByteHistory& byteHistory, unsigned char byte)
+{
+    if (byteHistory.window.size() < byteHistory.capacity)
+    {
+        byteHistory.window.push_back(byte);
+    }
+    else
+    {
+        byteHistory.window[byteHistory.length & (byteHistory.capacity - 1)] = byte;
+    }
 
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote()}));
-    assert(HistoricVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{}));
+    byteHistory.length++;
+}
 
-    statisticsHistory["0"] = HistoryEntry{{"", 1}};
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(0, 1.0, 0.0)}));
+unsigned char WindowByte(const ByteHistory& byteHistory, std::size_t position)
+{
+    return byteHistory.window[position & (byteHistory.capacity - 1)];
+}
 
-    statisticsHistory["1"] = HistoryEntry{{"", 2}};
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.0)}));
+void AdvancePosition(Predictor& predictor, unsigned char bit)
+{
+    const std::uint32_t byteMarker = 256;
+    ByteHistory& byteHistory = predictor.byteHistory;
 
-    statisticsPerformance[1] = Performance(1, 1);
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.5)}));
+    PushBit(predictor.bitHistory, bit);
+    predictor.operationStatus.position.inputPosition++;
+    predictor.operationStatus.position.virtualPosition++;
 
-    statisticsPerformance[1] = Performance(5, 1);
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83)}));
+    byteHistory.partialByte = (byteHistory.partialByte << 1) | bit;
 
-    statisticsModel.levels = 2;
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83), Vote(0, 0.0, 0.0)}));
-    assert(HistoricVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{}));
+    if (byteHistory.partialByte >= byteMarker)
+    {
+        PushByte(byteHistory, static_cast<unsigned char>(byteHistory.partialByte - byteMarker));
+        byteHistory.partialByte = 1;
+    }
+}
 
-    statisticsHistory["10"] = HistoryEntry{{"", 5}};
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83), Vote(1, 1.0, 0.0)}));
+BitHistory GuessedHistory(const Predictor& predictor, const std::vector<unsigned char>& guessedBits)
+{
+    BitHistory bitHistory = predictor.bitHistory;
 
-    testPredictor.operationStatus.position.virtualPosition = 1;
-    testGuessedBits = { 1 };
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83), Vote(0, 1.0, 0.0)}));
-    assert(HistoricVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(0, 0.0, 0.0)}));
+    for (unsigned char guessedBit: guessedBits)
+    {
+        PushBit(bitHistory, guessedBit);
+    }
 
-    testGuessedBits = { 0 };
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83), Vote(0, 0.0, 0.0)}));
+    return bitHistory;
+}
 
-    testPredictor.operationStatus.position.inputPosition = 1;
-    testPredictor.operationStatus.operation.inputBytes = { 128 };
-    testGuessedBits = {};
-    historicHistory["0"] = HistoryEntry{{"1", 1}};
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83), Vote(0, 1.0, 0.0)}));
-    assert(HistoricVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(0, 0.0, 0.0)}));
+std::uint64_t GenerateHistoricKey(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, std::size_t level)
+{
+    return GuessedHistory(predictor, guessedBits).recentBits & LowMask(level);
+}
 
-    historicHistory["1"] = HistoryEntry{{"1", 1}};
-    assert(HistoricVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 1.0, 0.0)}));
+#if defined(COMPRESSOR_TEST) || defined(COMPRESSOR_BENCHMARK)
+std::uint64_t WalkHistoricKey(std::span<const unsigned char> inputBytes, std::size_t inputPosition, std::size_t level)
+{
+    std::uint64_t key = 0;
 
-    historicHistory["1"] = HistoryEntry{{"0", 1 }, {"1", 4}};
-    assert(HistoricVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.8, 0.0)}));
+    for (std::size_t i = level; i > 0; i--)
+    {
+        key |= static_cast<std::uint64_t>(GetBitFromInput(inputBytes, inputPosition - ((level - i) + 1))) << (level - i);
+    }
 
-    testPredictor.operationStatus.operation.inputBytes = { 127 };
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83), Vote(0, 0.0, 0.0)}));
+    return key;
+}
+#endif
 
-    statisticsModel.levels = 3;
-    assert(StatisticsVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 0.67, 0.83), Vote(0, 0.0, 0.0)}));
+std::size_t VotingLevel(std::size_t index)
+{
+    const std::size_t doublingLevels = 3;
+    const std::size_t levelStep = 8;
 
-    testPredictor.operationStatus.position.inputPosition = 1;
-    testPredictor.operationStatus.position.virtualPosition = 2;
-    testPredictor.operationStatus.operation.inputBytes = { 128 };
-    testGuessedBits = { 0 };
-    historicModel.levels = 2;
-    historicHistory["10"] = HistoryEntry{{"0", 1 }, {"1", 4}};
-    assert(HistoricVotes(testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, 1.0, 0.0), Vote(1, 0.8, 0.0)}));
+    return index < doublingLevels ? static_cast<std::size_t>(1) << index : levelStep * (index - doublingLevels + 1);
+}
 
-    std::vector<Vote> votes;
-    std::vector<Vote> statisticsVotes;
-    std::vector<Vote> historicVotes;
+std::vector<std::size_t> VotingLevels(std::size_t levels)
+{
+    std::vector<std::size_t> votingLevels;
 
-    for (auto& [modelKey, predictionModel]: predictor.predictionModels)
+    for (std::size_t index = 0; VotingLevel(index) <= levels; index++)
     {
-        switch (predictionModel.model)
-        {
-            case Model::Statistics:
-                statisticsVotes = StatisticsVotes(predictor, guessedBits);
-                break;
-            case Model::HistoricDictionary:
-                historicVotes = HistoricVotes(predictor, guessedBits);
-                break;
-            case Model::FutureDictionary:
-                break;
-            case Model::Distance:
-                break;
-            default:
-                throw std::runtime_error("Unknown prediction model");
-        }
+        votingLevels.push_back(VotingLevel(index));
     }
 
-    return Guess();
+    return votingLevels;
 }
 
-std::vector<unsigned char> GuessBits(const Predictor& predictor)
+std::uint64_t NibbleKey(const PredictionModel& predictionModel, std::size_t level, std::uint64_t recentBits, std::size_t nibbleStart)
 {
-    double confidence = 1.0;
-    std::vector<unsigned char> guessedBits;
-
-    while (confidence > 0.5)
+    if (predictionModel.model == Model::HistoricDictionary)
     {
-        Guess guess = GuessBit(predictor, guessedBits);
-
-        guessedBits.push_back(guess.bit);
-        confidence *= guess.confidence;
+        return GenerateEntryKey(CombinationData(level, recentBits & LowMask(level)), nibbleStart % level);
     }
 
-    return std::vector<unsigned char>{1};
-}
+    const std::size_t blockOffset = level < nibbleBits ? 0 : nibbleStart % level;
 
-bool CheckGuess()
-{
-    return true;
+    return GeneratePartialKey(level, CombinationData(blockOffset, recentBits));
 }
 
-GuessResult MakeGuess(const Predictor& predictor)
+std::size_t NibbleNode(std::size_t blockBits, std::size_t nibbleBit, std::uint64_t recentBits)
 {
-    GuessResult guessResult;
-
-    guessResult.guessedBits = GuessBits(predictor);
-    guessResult.correct = CheckGuess();
+    const std::size_t offset = nibbleBit % std::min(blockBits, nibbleBits);
 
-    return guessResult;
+    return static_cast<std::size_t>((static_cast<std::uint64_t>(1) << offset) | (recentBits & LowMask(offset))) - 1;
 }
 
-void RecordGuess()
+bool HasContext(const PredictionModel& predictionModel, std::size_t level, std::size_t nibbleStart)
 {
-    return;
+    return predictionModel.model != Model::HistoricDictionary || nibbleStart >= level;
 }
 
-void RecordHistory()
+void SelectSlots(PredictionModel& predictionModel, std::uint64_t recentBits, std::size_t nibbleStart)
 {
-    return;
-}
+    History& history = predictionModel.history;
 
-std::string GetUsage() {
-    std::string usage = "Usage: ./Compressor <command> <target>\n\n";
-    usage += "Commands:\n";
-    usage += "  -c --compress   Compress target\n";
-    usage += "  -d --decompress Decompress target\n\n";
-    usage += "Examples:\n";
-    usage += "  Compress the file enwik3:\n";
-    usage += "    ./Compressor -c enwik3\n";
-    usage += "  Decompress the file enwik3.iw:\n";
-    usage += "    ./Compressor -d enwik3.iw";
+    if (history.activeNibble == nibbleStart)
+    {
+        return;
+    }
 
-    return usage;
+    history.activeSlots.clear();
+    history.activeNibble = nibbleStart;
+
+    for (std::size_t row = 0; VotingLevel(row) <= predictionModel.levels; row++)
+    {
+        const std::size_t level = VotingLevel(row);
+
+        if (!HasContext(predictionModel, level, nibbleStart))
+        {
+            break;
+        }
+
+        history.activeSlots.push_back(ContextIndex(history.historicData, NibbleKey(predictionModel, level, recentBits, nibbleStart)));
+    }
 }
 
-Action GetAction(const std::vector<std::string>& cliArguments)
+template <typename Pipeline = FullPipeline>
+void SelectPredictorSlots(Predictor& predictor)
 {
-    const std::size_t actionIndex = 1;
-    const std::string actionArgument = cliArguments.at(actionIndex);
+    const std::size_t virtualPosition = predictor.operationStatus.position.virtualPosition;
 
-    if (actionArgument == "-c" || actionArgument == "--compress")
+    if (virtualPosition % nibbleBits != 0)
     {
-        return Action::Compress;
+        return;
     }
-    else if (actionArgument == "-d" || actionArgument == "--decompress")
+
+    if constexpr (Pipeline::Contains(Model::Statistics))
     {
-        return Action::Decompress;
+        SelectSlots(predictor.predictionModels[Model::Statistics], predictor.bitHistory.recentBits, virtualPosition);
     }
-    else
+
+    if constexpr (Pipeline::Contains(Model::HistoricDictionary))
     {
-        throw std::runtime_error(actionArgument + " is not a valid command\n\n" + GetUsage());
+        SelectSlots(predictor.predictionModels[Model::HistoricDictionary], predictor.bitHistory.recentBits, virtualPosition);
     }
 }
 
-std::string GetTarget(const std::vector<std::string>& cliArguments)
-{
-    const std::size_t targetIndex = 2;
-    return cliArguments.at(targetIndex);
-}
-
-std::vector<unsigned char> ReadTarget(const std::string& target)
+const ContextSlot* ActiveSlot(
+    const PredictionModel& predictionModel,
+    std::size_t row,
+    std::uint64_t recentBits,
+    std::size_t nibbleStart)
 {
-    std::ifstream inputFile(target, std::ios::binary);
+    const History& history = predictionModel.history;
 
-    if (inputFile.fail())
+    if (history.activeNibble == nibbleStart)
     {
-        throw std::runtime_error("Could not read from file " + target);
+        return &TableSlot(history.historicData, history.activeSlots[row]);
     }
 
-    std::vector<unsigned char> inputBytes(
-        (std::istreambuf_iterator<char>(inputFile)),
-        (std::istreambuf_iterator<char>()));
+    return FindContext(history.historicData, NibbleKey(predictionModel, VotingLevel(row), recentBits, nibbleStart));
+}
 
-    return inputBytes;
+void UpdateSlot(PredictionModel& predictionModel, std::size_t row, std::size_t node, unsigned char bit)
+{
+    History& history = predictionModel.history;
+    std::uint8_t& state = TableSlot(history.historicData, history.activeSlots[row]).states[node];
+    AdaptiveProbability& mapped = history.stateMap[std::min(row, stateMapRows - 1) * stateCount + state];
+
+    Adapt(mapped.probability, mapped.count, bit, stateAdaptLimit);
+    state = stateTable[state].next[bit];
 }
 
-void ProcessTarget(const Operation& operation)
+Vote StateVote(const PredictionModel& predictionModel, std::size_t row, std::uint8_t state)
 {
-    const std::size_t numberBits = 8;
-    std::size_t correctBits = 0;
-    std::vector<unsigned char> outputBytes;
+    const Performance& performance = predictionModel.history.performance[row];
 
-    OperationStatus operationStatus;
-    operationStatus.operation = operation;
+    if (state == 0)
+    {
+        return Vote(0, 0, performance.accuracy);
+    }
 
-    std::unordered_map<std::string, PredictionModel> predictionModels;
-    predictionModels["Statistics"] = PredictionModel(Model::Statistics);
-    predictionModels["HistoricDictionary"] = PredictionModel(Model::HistoricDictionary);
-    predictionModels["FutureDictionary"] = PredictionModel(Model::FutureDictionary);
-    predictionModels["Distance"] = PredictionModel(Model::Distance);
+    const std::uint16_t probabilityOne =
+        predictionModel.history.stateMap[std::min(row, stateMapRows - 1) * stateCount + state].probability;
+    const unsigned char bit = probabilityOne > probabilityScale / 2 ? 1 : 0;
+    const std::int32_t confidence = bit == 1 ? probabilityOne : probabilityScale - probabilityOne;
 
-    Predictor predictor;
-    predictor.operationStatus = operationStatus;
-    predictor.predictionModels = predictionModels;
+    return Vote(bit, static_cast<std::uint16_t>(std::min(confidence, probabilityScale - 1)), performance.accuracy);
+}
+
+void ModelVotes(
+    const Predictor& predictor,
+    const PredictionModel& predictionModel,
+    const std::vector<unsigned char>& guessedBits,
+    std::vector<Vote>& votes)
+{
+    const std::size_t virtualPosition = predictor.operationStatus.position.virtualPosition;
+    const std::size_t nibbleBit = virtualPosition % nibbleBits;
+    const std::size_t nibbleStart = virtualPosition - nibbleBit;
+    const std::uint64_t recentBits = GenerateHistoricKey(predictor, guessedBits, 64);
 
-    while (correctBits != operation.inputBytes.size() * numberBits)
+    for (std::size_t row = 0; VotingLevel(row) <= predictionModel.levels; row++)
     {
-        GuessResult guessResult = MakeGuess(predictor);
-        RecordGuess();
-        RecordHistory();
+        const std::size_t level = VotingLevel(row);
 
-        if (guessResult.correct)
+        if (!HasContext(predictionModel, level, nibbleStart))
         {
-            correctBits += guessResult.guessedBits.size();
+            break;
         }
-    }
 
-    return;
-}
+        const ContextSlot* contextSlot = ActiveSlot(predictionModel, row, recentBits >> nibbleBit, nibbleStart);
+        const std::size_t blockBits = predictionModel.model == Model::Statistics ? level : nibbleBits;
 
-void ValidateArguments(const std::vector<std::string>& cliArguments) {
-    const std::size_t expectedArguments = 3;
+        const std::uint8_t state = contextSlot == nullptr ? 0 : contextSlot->states[NibbleNode(blockBits, nibbleBit, recentBits)];
 
-    if (cliArguments.size() != expectedArguments) {
-        throw std::runtime_error("Invalid number of command line arguments\n\n" + GetUsage());
+        votes.push_back(StateVote(predictionModel, row, state));
     }
 }
 
-Command GetCommand(const std::vector<std::string>& cliArguments)
+void RecordModel(Predictor& predictor, PredictionModel& predictionModel, unsigned char bit)
 {
-    assert(GetAction({"Compressor", "-c", "enwik3"}) == Action::Compress);
-    assert(GetAction({"Compressor", "-d", "enwik3"}) == Action::Decompress);
-    assert(GetAction({"Compressor", "--compress", "enwik3"}) == Action::Compress);
-    assert(GetAction({"Compressor", "--decompress", "enwik3"}) == Action::Decompress);
+    const std::size_t virtualPosition = predictor.operationStatus.position.virtualPosition;
+    const std::size_t nibbleBit = virtualPosition % nibbleBits;
+    const std::uint64_t recentBits = predictor.bitHistory.recentBits;
 
-    assert(GetTarget({"Compressor", "-c", "enwik3"}) == "enwik3");
-    assert(GetTarget({"Compressor", "-c", "enwik5"}) == "enwik5");
-    assert(GetTarget({"Compressor", "-c", "enwik7"}) == "enwik7");
-    assert(GetTarget({"Compressor", "-c", "enwik9"}) == "enwik9");
+    SelectSlots(predictionModel, recentBits >> nibbleBit, virtualPosition - nibbleBit);
 
-    Command command;
+    for (std::size_t row = 0; row < predictionModel.history.activeSlots.size(); row++)
+    {
+        const std::size_t blockBits = predictionModel.model == Model::Statistics ? VotingLevel(row) : nibbleBits;
 
-    command.action = GetAction(cliArguments);
-    command.target = GetTarget(cliArguments);
+        UpdateSlot(predictionModel, row, NibbleNode(blockBits, nibbleBit, recentBits), bit);
+    }
+}
 
-    return command;
+void StatisticsVotes(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, std::vector<Vote>& votes)
+{
+    ModelVotes(predictor, predictor.predictionModels.at(Model::Statistics), guessedBits, votes);
 }
 
-void ExecuteCommand(const Command& command)
+void RecordStatistics(Predictor& predictor, unsigned char bit)
 {
-    assert(ReadTarget("enwik") == (std::vector<unsigned char>{}));
-    assert(ReadTarget("enwik1") == (std::vector<unsigned char>{'<', 'm', 'e', 'd', 'i', 'a', 'w', 'i', 'k', 'i'}));
-    assert(ReadTarget("enwik2").size() == 100);
-    assert(ReadTarget("enwik3").size() == 1000);
+    RecordModel(predictor, predictor.predictionModels.at(Model::Statistics), bit);
+}
 
-    Operation operation;
+void HistoricVotes(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, std::vector<Vote>& votes)
+{
+    ModelVotes(predictor, predictor.predictionModels.at(Model::HistoricDictionary), guessedBits, votes);
+}
 
-    operation.command = command;
-    operation.inputBytes = ReadTarget(command.target);
+std::uint64_t RecentBytes(const ByteHistory& byteHistory, std::size_t count)
+{
+    std::uint64_t recentBytes = 0;
 
-    ProcessTarget(operation);
+    for (std::size_t offset = 1; offset <= count; offset++)
+    {
+        recentBytes = (recentBytes << 8) | WindowByte(byteHistory, byteHistory.length - offset);
+    }
 
-    return;
+    return recentBytes;
 }
 
-int main(int argc, char* argv[])
+std::size_t MatchIndex(std::uint64_t recentBytes, std::size_t tableSize)
 {
-    assert(GetCommand({"Compressor", "-c", "enwik3"}) == Command(Action::Compress, "enwik3"));
-    assert(GetCommand({"Compressor", "-d", "enwik5"}) == Command(Action::Decompress, "enwik5"));
-    assert(GetCommand({"Compressor", "--compress", "enwik7"}) == Command(Action::Compress, "enwik7"));
-    assert(GetCommand({"Compressor", "--decompress", "enwik9"}) == Command(Action::Decompress, "enwik9"));
+    return static_cast<std::size_t>((recentBytes * hashMultiplier) >> 32) & (tableSize - 1);
+}
 
+std::size_t MatchHash(const ByteHistory& byteHistory, std::size_t tableSize)
+{
+    return MatchIndex(RecentBytes(byteHistory, matchMinimum), tableSize);
+}
+
+unsigned char PredictedMatchBit(const Predictor& predictor, std::size_t virtualPosition)
+{
+    const MatchHistory& match = predictor.predictionModels.at(Model::Distance).history.match;
+    const std::size_t byteOffset = virtualPosition / 8 - predictor.operationStatus.position.inputPosition / 8;
+    const unsigned char predictedByte = WindowByte(predictor.byteHistory, match.matchPointer + byteOffset);
+
+    return (predictedByte >> (7 - virtualPosition % 8)) & 1;
+}
+
+Vote PredictedByteVote(
+    const Predictor& predictor,
+    const std::vector<unsigned char>& guessedBits,
+    const PredictionModel& predictionModel,
+    unsigned char predictedByte,
+    const Performance& bucketPerformance)
+{
+    const std::size_t virtualPosition = predictor.operationStatus.position.virtualPosition;
+    const std::size_t bitIndex = virtualPosition % 8;
+    const std::uint64_t knownBits = GuessedHistory(predictor, guessedBits).recentBits & LowMask(bitIndex);
+
+    if ((static_cast<std::uint64_t>(predictedByte) >> (8 - bitIndex)) != knownBits)
+    {
+        return Vote();
+    }
+
+    const Performance& performance = predictionModel.history.performance.front();
+
+    Vote vote;
+    vote.bit = (predictedByte >> (7 - bitIndex)) & 1;
+    vote.voteWeight.confidence = std::max<std::uint16_t>(1, bucketPerformance.accuracy);
+    vote.voteWeight.performance = performance.accuracy;
+
+    return vote;
+}
+
+void DistanceVotes(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, std::vector<Vote>& votes)
+{
+    const PredictionModel& distanceModel = predictor.predictionModels.at(Model::Distance);
+    const MatchHistory& match = distanceModel.history.match;
+    const std::size_t byteOffset =
+        predictor.operationStatus.position.virtualPosition / 8 - predictor.operationStatus.position.inputPosition / 8;
+
+    if (match.matchLength == 0 || match.matchPointer + byteOffset >= predictor.byteHistory.length)
+    {
+        votes.push_back(Vote());
+        return;
+    }
+
+    const unsigned char predictedByte = WindowByte(predictor.byteHistory, match.matchPointer + byteOffset);
+    const Performance& lengthPerformance =
+        match.lengthPerformance[std::min(match.matchLength, match.lengthPerformance.size() - 1)];
+
+    votes.push_back(PredictedByteVote(predictor, guessedBits, distanceModel, predictedByte, lengthPerformance));
+}
+
+unsigned char PredictedDictionaryBit(const Predictor& predictor, std::size_t virtualPosition)
+{
+    const DictionaryHistory& dictionary = predictor.predictionModels.at(Model::FutureDictionary).history.dictionary;
+    const std::size_t byteOffset = virtualPosition / 8 - predictor.operationStatus.position.inputPosition / 8;
+    const unsigned char predictedByte = dictionary.entries[dictionary.activeEntry][dictionary.entryOffset + byteOffset];
+
+    return (predictedByte >> (7 - virtualPosition % 8)) & 1;
+}
+
+void FutureVotes(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, std::vector<Vote>& votes)
+{
+    const PredictionModel& futureModel = predictor.predictionModels.at(Model::FutureDictionary);
+    const DictionaryHistory& dictionary = futureModel.history.dictionary;
+    const std::size_t byteOffset =
+        predictor.operationStatus.position.virtualPosition / 8 - predictor.operationStatus.position.inputPosition / 8;
+
+    if (dictionary.entryOffset == 0 ||
+        dictionary.entryOffset + byteOffset >= dictionary.entries[dictionary.activeEntry].size())
+    {
+        votes.push_back(Vote());
+        return;
+    }
+
+    const unsigned char predictedByte = dictionary.entries[dictionary.activeEntry][dictionary.entryOffset + byteOffset];
+    const Performance& offsetPerformance =
+        dictionary.offsetPerformance[std::min(dictionary.entryOffset, dictionary.offsetPerformance.size() - 1)];
+
+    votes.push_back(PredictedByteVote(predictor, guessedBits, futureModel, predictedByte, offsetPerformance));
+}
+
+std::int16_t VoteInput(const Vote& vote)
+{
+    if (vote.voteWeight.confidence == 0)
+    {
+        return 0;
+    }
+
+    const std::int32_t probabilityOne =
+        vote.bit == 1 ? vote.voteWeight.confidence : probabilityScale - vote.voteWeight.confidence;
+
+    return static_cast<std::int16_t>((Stretch(probabilityOne) * vote.voteWeight.performance) >> probabilityBits);
+}
+
+std::size_t MixerContext(const Predictor& predictor, const Guess& guess)
+{
+    const std::size_t bitIndex = predictor.operationStatus.position.virtualPosition % 8;
+    const std::size_t matchActive = !guess.distanceVotes.empty() && guess.distanceVotes.front().voteWeight.confidence != 0;
+    const std::size_t entryActive = !guess.futureVotes.empty() && guess.futureVotes.front().voteWeight.confidence != 0;
+
+    return (bitIndex << 2) | (matchActive << 1) | entryActive;
+}
+
+std::int32_t DotProduct(const std::int16_t* inputs, const std::int16_t* weights, std::size_t count)
+{
+    std::size_t index = 0;
+    std::int32_t sum = 0;
+
+#if defined(__AVX2__)
+    __m256i vectorSum = _mm256_setzero_si256();
+
+    for (; index + 16 <= count; index += 16)
+    {
+        const __m256i products = _mm256_madd_epi16(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputs + index)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + index)));
+        vectorSum = _mm256_add_epi32(vectorSum, _mm256_srai_epi32(products, 8));
+    }
+
+    __m128i halfSum = _mm_add_epi32(_mm256_castsi256_si128(vectorSum), _mm256_extracti128_si256(vectorSum, 1));
+    halfSum = _mm_add_epi32(halfSum, _mm_srli_si128(halfSum, 8));
+    halfSum = _mm_add_epi32(halfSum, _mm_srli_si128(halfSum, 4));
+    sum = _mm_cvtsi128_si32(halfSum);
+#elif defined(__SSE2__)
+    __m128i vectorSum = _mm_setzero_si128();
+
+    for (; index + 8 <= count; index += 8)
+    {
+        const __m128i products = _mm_madd_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputs + index)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + index)));
+        vectorSum = _mm_add_epi32(vectorSum, _mm_srai_epi32(products, 8));
+    }
+
+    vectorSum = _mm_add_epi32(vectorSum, _mm_srli_si128(vectorSum, 8));
+    vectorSum = _mm_add_epi32(vectorSum, _mm_srli_si128(vectorSum, 4));
+    sum = _mm_cvtsi128_si32(vectorSum);
+#endif
+
+    for (; index + 2 <= count; index += 2)
+    {
+        sum += (inputs[index] * weights[index] + inputs[index + 1] * weights[index + 1]) >> 8;
+    }
+
+    return sum;
+}
+
+std::int16_t SaturateWeight(std::int32_t weight)
+{
+    return static_cast<std::int16_t>(std::min<std::int32_t>(std::max<std::int32_t>(weight, -32768), 32767));
+}
+
+void TrainWeights(const std::int16_t* inputs, std::int16_t* weights, std::size_t count, std::int16_t error)
+{
+    std::size_t index = 0;
+
+#if defined(__AVX2__)
+    const __m256i vectorError = _mm256_set1_epi16(error);
+    const __m256i vectorOne = _mm256_set1_epi16(1);
+
+    for (; index + 16 <= count; index += 16)
+    {
+        const __m256i scaledInputs = _mm256_slli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputs + index)), 3);
+        const __m256i update = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_mulhi_epi16(scaledInputs, vectorError), vectorOne), 1);
+        __m256i* weightVector = reinterpret_cast<__m256i*>(weights + index);
+        _mm256_storeu_si256(weightVector, _mm256_adds_epi16(_mm256_loadu_si256(weightVector), update));
+    }
+#elif defined(__SSE2__)
+    const __m128i vectorError = _mm_set1_epi16(error);
+    const __m128i vectorOne = _mm_set1_epi16(1);
+
+    for (; index + 8 <= count; index += 8)
+    {
+        const __m128i scaledInputs = _mm_slli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputs + index)), 3);
+        const __m128i update = _mm_srai_epi16(_mm_adds_epi16(_mm_mulhi_epi16(scaledInputs, vectorError), vectorOne), 1);
+        __m128i* weightVector = reinterpret_cast<__m128i*>(weights + index);
+        _mm_storeu_si128(weightVector, _mm_adds_epi16(_mm_loadu_si128(weightVector), update));
+    }
+#endif
+
+    for (; index < count; index++)
+    {
+        const std::int32_t update = ((((inputs[index] << 3) * error) >> 16) + 1) >> 1;
+        weights[index] = SaturateWeight(weights[index] + update);
+    }
+}
+
+void InitializeMixer(Mixer& mixer, std::size_t inputs, std::size_t contexts)
+{
+    const std::size_t vectorWidth = 16;
+    const std::int16_t initialWeight = 2458;
+
+    mixer.inputCount = (inputs + vectorWidth - 1) / vectorWidth * vectorWidth;
+    mixer.contexts = contexts;
+    mixer.weights.assign(mixer.inputCount * contexts, initialWeight);
+}
+
+void InitializeProbabilityMap(ProbabilityMap& probabilityMap, std::size_t contexts)
+{
+    probabilityMap.contexts = contexts;
+    probabilityMap.ownedCells.resize(contexts * mapBuckets);
+    probabilityMap.cells = probabilityMap.ownedCells;
+
+    for (std::size_t context = 0; context < contexts; context++)
+    {
+        for (std::size_t bucket = 0; bucket < mapBuckets; bucket++)
+        {
+            const std::int32_t stretched = (static_cast<std::int32_t>(bucket) - static_cast<std::int32_t>(mapBuckets / 2)) * bucketWidth;
+            probabilityMap.cells[context * mapBuckets + bucket].probability = static_cast<std::uint16_t>(Squash(stretched));
+        }
+    }
+}
+
+std::size_t MapContextCount(std::size_t contexts, std::uint64_t mapMemory)
+{
+    const std::uint64_t contextBytes = mapBuckets * sizeof(AdaptiveProbability);
+    const std::size_t minimumContexts = 1 << 8;
+
+    if (contexts * contextBytes <= mapMemory)
+    {
+        return contexts;
+    }
+
+    return std::max<std::size_t>(minimumContexts, static_cast<std::size_t>(std::bit_floor(mapMemory / contextBytes)));
+}
+
+std::array<std::size_t, mapCount> MapContextCounts(std::uint64_t mapMemory)
+{
+    const std::uint64_t contextBytes = mapBuckets * sizeof(AdaptiveProbability);
+    const std::size_t orderZeroContexts = 1 << 8;
+    const std::size_t matchContexts = MapContextCount(17 << 8, (mapMemory - orderZeroContexts * contextBytes) / 2);
+
+    return {orderZeroContexts, MapContextCount(1 << 16, mapMemory - (orderZeroContexts + matchContexts) * contextBytes), matchContexts};
+}
+
+std::size_t MapContext(std::size_t context, std::size_t contexts)
+{
+    if (context < contexts)
+    {
+        return context;
+    }
+
+    const std::size_t rows = contexts >> 8;
+    const std::size_t row = static_cast<std::size_t>(((context >> 8) * hashMultiplier) >> 32) & (rows - 1);
+
+    return (row << 8) | (context & 0xFF);
+}
+
+std::array<std::size_t, mapCount> MapContexts(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, const Guess& guess)
+{
+    const std::size_t bitIndex = predictor.operationStatus.position.virtualPosition % 8;
+    const std::size_t partialByte = (static_cast<std::size_t>(1) << bitIndex) |
+        static_cast<std::size_t>(GuessedHistory(predictor, guessedBits).recentBits & LowMask(bitIndex));
+    const ByteHistory& byteHistory = predictor.byteHistory;
+    const std::size_t previousByte = byteHistory.length == 0 ? 0 : WindowByte(byteHistory, byteHistory.length - 1);
+
+    std::size_t matchState = 0;
+
+    if (!guess.distanceVotes.empty() && guess.distanceVotes.front().voteWeight.confidence != 0)
+    {
+        const Vote& matchVote = guess.distanceVotes.front();
+        matchState = 1 + matchVote.bit + 2 * (matchVote.voteWeight.confidence >> (probabilityBits - 3));
+    }
+
+    return {partialByte, (previousByte << 8) | partialByte, (matchState << 8) | partialByte};
+}
+
+std::int32_t RefineProbability(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, Guess& guess)
+{
+    const std::int32_t stretched = Stretch(guess.mixerProbability) + stretchLimit + 1;
+    const std::size_t bucket = static_cast<std::size_t>(stretched / bucketWidth);
+    const std::array<std::size_t, mapCount> contexts = MapContexts(predictor, guessedBits, guess);
+
+    guess.mapWeight = stretched % bucketWidth;
+    std::int32_t refined = 0;
+
+    for (std::size_t map = 0; map < mapCount; map++)
+    {
+        const ProbabilityMap& probabilityMap = predictor.probabilityMaps[map];
+        const std::size_t cell = MapContext(contexts[map], probabilityMap.contexts) * mapBuckets + bucket;
+        const std::int32_t low = probabilityMap.cells[cell].probability;
+        const std::int32_t high = probabilityMap.cells[cell + 1].probability;
+
+        guess.mapCells[map] = cell;
+        refined += (low * (bucketWidth - guess.mapWeight) + high * guess.mapWeight) / bucketWidth;
+    }
+
+    return (guess.mixerProbability + refined * 3 / static_cast<std::int32_t>(mapCount)) / 4;
+}
+
+template <Model model>
+void GuessModel(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, Guess& guess)
+{
+    const std::chrono::steady_clock::time_point modelStart = StartModelClock();
+
+    if constexpr (model == Model::Statistics)
+    {
+        StatisticsVotes(predictor, guessedBits, guess.statisticsVotes);
+    }
+    else if constexpr (model == Model::HistoricDictionary)
+    {
+        HistoricVotes(predictor, guessedBits, guess.historicVotes);
+    }
+    else if constexpr (model == Model::FutureDictionary)
+    {
+        FutureVotes(predictor, guessedBits, guess.futureVotes);
+    }
+    else
+    {
+        DistanceVotes(predictor, guessedBits, guess.distanceVotes);
+    }
+
+    StopModelClock(predictor.predictionModels[model].elapsed, modelStart);
+}
+
+template <typename Pipeline = FullPipeline>
+void GuessModels(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, Guess& guess)
+{
+    guess.statisticsVotes.clear();
+    guess.historicVotes.clear();
+    guess.distanceVotes.clear();
+    guess.futureVotes.clear();
+
+    Pipeline::ForEach([&predictor, &guessedBits, &guess](auto model)
+    {
+        GuessModel<decltype(model)::value>(predictor, guessedBits, guess);
+    });
+}
+
+void MixVotes(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, Guess& guess)
+{
+    const std::vector<Vote>& statisticsVotes = guess.statisticsVotes;
+    const std::vector<Vote>& historicVotes = guess.historicVotes;
+    const std::vector<Vote>& distanceVotes = guess.distanceVotes;
+    const std::vector<Vote>& futureVotes = guess.futureVotes;
+
+    const std::chrono::steady_clock::time_point mixerStart = StartModelClock();
+    const Mixer& mixer = predictor.mixer;
+    const std::int16_t biasInput = 128;
+    std::size_t input = 0;
+
+    guess.mixerInputs.assign(mixer.inputCount, 0);
+
+    for (const std::vector<Vote>* modelVotes: {&statisticsVotes, &historicVotes, &distanceVotes, &futureVotes})
+    {
+        if (input + modelVotes->size() >= mixer.inputCount)
+        {
+            throw std::runtime_error("Mixer has fewer inputs than the active models vote");
+        }
+
+        for (const Vote& vote: *modelVotes)
+        {
+            guess.mixerInputs[input++] = VoteInput(vote);
+        }
+    }
+
+    guess.mixerInputs[input] = biasInput;
+    guess.mixerContext = MixerContext(predictor, guess);
+
+    const std::int16_t* weights = mixer.weights.data() + guess.mixerContext * mixer.inputCount;
+    guess.mixerProbability = static_cast<std::uint16_t>(Squash(DotProduct(guess.mixerInputs.data(), weights, mixer.inputCount) >> 5));
+
+    const std::int32_t probabilityOne = std::min(std::max(RefineProbability(predictor, guessedBits, guess), 1), probabilityScale - 1);
+
+    guess.bit = probabilityOne >= probabilityScale / 2 ? 1 : 0;
+    guess.confidence = static_cast<std::uint16_t>(guess.bit == 1 ? probabilityOne : probabilityScale - probabilityOne);
+    StopModelClock(mixer.elapsed, mixerStart);
+}
+
+template <typename Pipeline = FullPipeline>
+void GuessBit(const Predictor& predictor, const std::vector<unsigned char>& guessedBits, Guess& guess)
+{
+    GuessModels<Pipeline>(predictor, guessedBits, guess);
+    MixVotes(predictor, guessedBits, guess);
+}
+
+template <typename Pipeline = FullPipeline>
+RunGuess GuessBits(const Predictor& predictor, std::uint64_t remainingBytes)
+{
+    const std::size_t wordBytes = 8;
+    const std::size_t entryRunFraction = 4;
+    RunGuess runGuess;
+
+    if (predictor.byteHistory.partialByte != 1 || predictor.runMinimumMatch == 0)
+    {
+        return runGuess;
+    }
+
+    if constexpr (Pipeline::Contains(Model::Distance))
+    {
+        const ByteHistory& byteHistory = predictor.byteHistory;
+        const MatchHistory& match = predictor.predictionModels[Model::Distance].history.match;
+
+        if (match.matchLength >= predictor.runMinimumMatch)
+        {
+            const std::size_t runBytes = static_cast<std::size_t>(
+                std::min<std::uint64_t>({wordBytes, byteHistory.length - match.matchPointer, remainingBytes}));
+
+            for (std::size_t byteIndex = 0; byteIndex < runBytes; byteIndex++)
+            {
+                runGuess.bits |= static_cast<std::uint64_t>(WindowByte(byteHistory, match.matchPointer + byteIndex))
+                    << (56 - byteIndex * 8);
+            }
+
+            runGuess.length = runBytes * 8;
+
+            return runGuess;
+        }
+    }
+
+    if constexpr (Pipeline::Contains(Model::FutureDictionary))
+    {
+        const DictionaryHistory& dictionary = predictor.predictionModels[Model::FutureDictionary].history.dictionary;
+
+        if (dictionary.entryOffset > 0 && dictionary.entryOffset >= predictor.runMinimumMatch / entryRunFraction)
+        {
+            const std::vector<unsigned char>& entry = dictionary.entries[dictionary.activeEntry];
+            const std::size_t runBytes = static_cast<std::size_t>(
+                std::min<std::uint64_t>({wordBytes, entry.size() - dictionary.entryOffset, remainingBytes}));
+
+            for (std::size_t byteIndex = 0; byteIndex < runBytes; byteIndex++)
+            {
+                runGuess.bits |= static_cast<std::uint64_t>(entry[dictionary.entryOffset + byteIndex]) << (56 - byteIndex * 8);
+            }
+
+            runGuess.length = runBytes * 8;
+        }
+    }
+
+    return runGuess;
+}
+
+std::uint64_t InputWord(std::span<const unsigned char> inputBytes, std::size_t bytePosition, std::size_t length)
+{
+    std::uint64_t word = 0;
+
+    for (std::size_t byteIndex = 0; byteIndex * 8 < length; byteIndex++)
+    {
+        word |= static_cast<std::uint64_t>(inputBytes[bytePosition + byteIndex]) << (56 - byteIndex * 8);
+    }
+
+    return word;
+}
+
+unsigned char RunBit(const RunGuess& runGuess, std::size_t bitIndex)
+{
+    return static_cast<unsigned char>((runGuess.bits >> (63 - bitIndex)) & 1);
+}
+
+bool CheckGuess(const Guess& guess, unsigned char bit)
+{
+    return guess.bit == bit;
+}
+
+std::size_t CheckGuess(const RunGuess& runGuess, std::uint64_t actualBits)
+{
+    return std::min<std::size_t>(std::countl_zero(runGuess.bits ^ actualBits), runGuess.length);
+}
+
+template <typename Pipeline = FullPipeline>
+void MakeGuess(const Predictor& predictor, unsigned char bit, GuessResult& guessResult)
+{
+    guessResult.guessedBits.clear();
+    GuessBit<Pipeline>(predictor, guessResult.guessedBits, guessResult.guess);
+    guessResult.guessedBits.push_back(guessResult.guess.bit);
+    guessResult.correct = CheckGuess(guessResult.guess, bit);
+}
+
+void RecordPerformance(PredictionModel& predictionModel, const std::vector<Vote>& votes, unsigned char bit)
+{
+    for (std::size_t index = 0; index < std::min(votes.size(), votingRows) && VotingLevel(index) <= predictionModel.levels; index++)
+    {
+        if (votes[index].voteWeight.confidence == 0)
+        {
+            continue;
+        }
+
+        Performance& performance = predictionModel.history.performance[index];
+        Adapt(performance.accuracy, performance.count, votes[index].bit == bit ? 1 : 0, performanceAdaptLimit);
+    }
+}
+
+void RecordBucket(std::vector<Performance>& bucketPerformance, std::size_t bucket, const Vote& vote, unsigned char bit)
+{
+    if (vote.voteWeight.confidence == 0)
+    {
+        return;
+    }
+
+    Performance& performance = bucketPerformance[std::min(bucket, bucketPerformance.size() - 1)];
+    Adapt(performance.accuracy, performance.count, vote.bit == bit ? 1 : 0, performanceAdaptLimit);
+}
+
+void RecordMixer(Predictor& predictor, const Guess& guess, unsigned char bit)
+{
+    const std::int32_t learningRate = 6;
+    const std::chrono::steady_clock::time_point mixerStart = StartModelClock();
+
+    Mixer& mixer = predictor.mixer;
+    const std::int16_t error = static_cast<std::int16_t>(((bit << probabilityBits) - guess.mixerProbability) * learningRate);
+
+    TrainWeights(guess.mixerInputs.data(), mixer.weights.data() + guess.mixerContext * mixer.inputCount, mixer.inputCount, error);
+    StopModelClock(mixer.elapsed, mixerStart);
+}
+
+void RecordProbabilityMaps(Predictor& predictor, const Guess& guess, unsigned char bit)
+{
+    const std::chrono::steady_clock::time_point mixerStart = StartModelClock();
+
+    for (std::size_t map = 0; map < mapCount; map++)
+    {
+        AdaptiveProbability& cell =
+            predictor.probabilityMaps[map].cells[guess.mapCells[map] + (guess.mapWeight * 2 >= bucketWidth ? 1 : 0)];
+
+        Adapt(cell.probability, cell.count, bit, mapAdaptLimit);
+    }
+
+    StopModelClock(predictor.mixer.elapsed, mixerStart);
+}
+
+template <typename Pipeline = FullPipeline>
+void RecordModelPerformance(Predictor& predictor, const Guess& guess, unsigned char bit)
+{
+    if constexpr (Pipeline::Contains(Model::Statistics))
+    {
+        RecordPerformance(predictor.predictionModels.at(Model::Statistics), guess.statisticsVotes, bit);
+    }
+
+    if constexpr (Pipeline::Contains(Model::HistoricDictionary))
+    {
+        RecordPerformance(predictor.predictionModels.at(Model::HistoricDictionary), guess.historicVotes, bit);
+    }
+
+    if constexpr (Pipeline::Contains(Model::Distance))
+    {
+        PredictionModel& distanceModel = predictor.predictionModels.at(Model::Distance);
+        MatchHistory& match = distanceModel.history.match;
+
+        RecordPerformance(distanceModel, guess.distanceVotes, bit);
+        RecordBucket(match.lengthPerformance, match.matchLength, guess.distanceVotes.front(), bit);
+    }
+
+    if constexpr (Pipeline::Contains(Model::FutureDictionary))
+    {
+        PredictionModel& futureModel = predictor.predictionModels.at(Model::FutureDictionary);
+        DictionaryHistory& dictionary = futureModel.history.dictionary;
+
+        RecordPerformance(futureModel, guess.futureVotes, bit);
+        RecordBucket(dictionary.offsetPerformance, dictionary.entryOffset, guess.futureVotes.front(), bit);
+    }
+}
+
+void RecordHistoric(Predictor& predictor, unsigned char bit)
+{
+    RecordModel(predictor, predictor.predictionModels.at(Model::HistoricDictionary), bit);
+}
+
+void RecordDistance(Predictor& predictor, unsigned char bit)
+{
+    MatchHistory& match = predictor.predictionModels.at(Model::Distance).history.match;
+
+    if (match.matchLength > 0 && PredictedMatchBit(predictor, predictor.operationStatus.position.virtualPosition) != bit)
+    {
+        match.matchLength = 0;
+    }
+}
+
+void RecordFuture(Predictor& predictor, unsigned char bit)
+{
+    DictionaryHistory& dictionary = predictor.predictionModels.at(Model::FutureDictionary).history.dictionary;
+
+    if (dictionary.entryOffset > 0 && PredictedDictionaryBit(predictor, predictor.operationStatus.position.virtualPosition) != bit)
+    {
+        dictionary.entryOffset = 0;
+    }
+}
+
+std::size_t DictionaryIndex(std::uint32_t prefix, std::size_t indexSize)
+{
+    return static_cast<std::size_t>((prefix * hashMultiplier) >> 32) & (indexSize - 1);
+}
+
+std::uint32_t DictionaryPrefix(const std::vector<unsigned char>& entry)
+{
+    return (static_cast<std::uint32_t>(entry[0]) << 24) | (static_cast<std::uint32_t>(entry[1]) << 16) |
+        (static_cast<std::uint32_t>(entry[2]) << 8) | entry[3];
+}
+
+void IndexDictionary(DictionaryHistory& dictionary, const std::vector<std::vector<unsigned char>>& entries)
+{
+    std::size_t indexSize = 16;
+
+    while (indexSize < entries.size() * 2)
+    {
+        indexSize *= 2;
+    }
+
+    dictionary = DictionaryHistory();
+    dictionary.entries = entries;
+    dictionary.index.resize(indexSize);
+
+    for (std::size_t entry = 0; entry < entries.size(); entry++)
+    {
+        if (entries[entry].size() <= dictionaryPrefix)
+        {
+            continue;
+        }
+
+        std::uint32_t& slot = dictionary.index[DictionaryIndex(DictionaryPrefix(entries[entry]), indexSize)];
+
+        if (slot == 0)
+        {
+            slot = static_cast<std::uint32_t>(entry + 1);
+        }
+    }
+}
+
+void RecordDictionary(Predictor& predictor)
+{
+    const ByteHistory& byteHistory = predictor.byteHistory;
+    DictionaryHistory& dictionary = predictor.predictionModels.at(Model::FutureDictionary).history.dictionary;
+
+    if (dictionary.entryOffset > 0)
+    {
+        dictionary.entryOffset++;
+
+        if (dictionary.entryOffset >= dictionary.entries[dictionary.activeEntry].size())
+        {
+            dictionary.entryOffset = 0;
+        }
+    }
+
+    if (dictionary.entryOffset > 0 || dictionary.index.empty() || byteHistory.length < dictionaryPrefix)
+    {
+        return;
+    }
+
+    std::uint32_t prefix = 0;
+
+    for (std::size_t offset = dictionaryPrefix; offset > 0; offset--)
+    {
+        prefix = (prefix << 8) | WindowByte(byteHistory, byteHistory.length - offset);
+    }
+
+    const std::uint32_t slot = dictionary.index[DictionaryIndex(prefix, dictionary.index.size())];
+
+    if (slot != 0 && DictionaryPrefix(dictionary.entries[slot - 1]) == prefix)
+    {
+        dictionary.activeEntry = slot - 1;
+        dictionary.entryOffset = dictionaryPrefix;
+    }
+}
+
+void RecordMatch(Predictor& predictor)
+{
+    const std::size_t matchMaximum = 65535;
+    const std::size_t tableSize = 1 << 18;
+
+    const ByteHistory& byteHistory = predictor.byteHistory;
+    MatchHistory& match = predictor.predictionModels.at(Model::Distance).history.match;
+
+    if (match.positions.empty())
+    {
+        match.positions.resize(tableSize);
+    }
+
+    if (match.matchLength > 0)
+    {
+        match.matchPointer++;
+        match.matchLength = std::min(match.matchLength + 1, matchMaximum);
+    }
+
+    if (byteHistory.length < matchMinimum)
+    {
+        return;
+    }
+
+    const std::size_t hash = MatchHash(byteHistory, match.positions.size());
+    const std::size_t candidate = match.positions[hash];
+
+    if (match.matchLength == 0 && candidate > 0 && byteHistory.length - candidate < byteHistory.capacity)
+    {
+        std::size_t length = 0;
+
+        while (length < candidate && length < matchMaximum && byteHistory.length - candidate + length < byteHistory.capacity &&
+            WindowByte(byteHistory, candidate - 1 - length) == WindowByte(byteHistory, byteHistory.length - 1 - length))
+        {
+            length++;
+        }
+
+        if (length >= matchMinimum)
+        {
+            match.matchLength = length;
+            match.matchPointer = candidate;
+        }
+    }
+
+    match.positions[hash] = static_cast<std::uint32_t>(byteHistory.length);
+}
+
+template <Model model>
+void RecordModelHistory(Predictor& predictor, unsigned char bit)
+{
+    const std::chrono::steady_clock::time_point modelStart = StartModelClock();
+
+    if constexpr (model == Model::Statistics)
+    {
+        RecordStatistics(predictor, bit);
+    }
+    else if constexpr (model == Model::HistoricDictionary)
+    {
+        RecordHistoric(predictor, bit);
+    }
+    else if constexpr (model == Model::FutureDictionary)
+    {
+        RecordFuture(predictor, bit);
+    }
+    else
+    {
+        RecordDistance(predictor, bit);
+    }
+
+    StopModelClock(predictor.predictionModels[model].elapsed, modelStart);
+}
+
+template <typename Pipeline = FullPipeline>
+void RecordHistory(Predictor& predictor, unsigned char bit)
+{
+    Pipeline::ForEach([&predictor, bit](auto model)
+    {
+        RecordModelHistory<decltype(model)::value>(predictor, bit);
+    });
+}
+
+std::uint32_t GuessProbability(const Guess& guess)
+{
+    const std::int32_t probabilityOne = guess.bit == 1 ? guess.confidence : probabilityScale - guess.confidence;
+
+    return static_cast<std::uint32_t>(std::min(std::max(probabilityOne, 1), probabilityScale - 1));
+}
+
+void OpenSink(ByteSink& byteSink, const std::string& target)
+{
+    byteSink.outputFile.open(target, std::ios::binary | std::ios::trunc);
+
+    if (byteSink.outputFile.fail())
+    {
+        throw std::runtime_error("Could not write to file " + target);
+    }
+}
+
+void OpenSinkAt(ByteSink& byteSink, const std::string& target, std::uint64_t offset)
+{
+    byteSink.outputFile.open(target, std::ios::binary | std::ios::in | std::ios::out);
+    byteSink.outputFile.seekp(static_cast<std::streamoff>(offset));
+
+    if (byteSink.outputFile.fail())
+    {
+        throw std::runtime_error("Could not write to file " + target);
+    }
+}
+
+void FlushSink(ByteSink& byteSink)
+{
+    if (byteSink.memory != nullptr)
+    {
+        byteSink.memory->insert(byteSink.memory->end(), byteSink.buffer.begin(), byteSink.buffer.begin() + byteSink.used);
+    }
+    else if (!byteSink.discard)
+    {
+        byteSink.outputFile.write(reinterpret_cast<const char*>(byteSink.buffer.data()), byteSink.used);
+    }
+
+    byteSink.written += byteSink.used;
+    byteSink.used = 0;
+
+    if (byteSink.outputFile.fail())
+    {
+        throw std::runtime_error("Could not write compressed output");
+    }
+}
+
+void PutByte(ByteSink& byteSink, unsigned char byte)
+{
+    byteSink.buffer[byteSink.used++] = byte;
+
+    if (byteSink.used == byteSink.buffer.size())
+    {
+        FlushSink(byteSink);
+    }
+}
+
+void PutBytes(ByteSink& byteSink, std::span<const unsigned char> bytes)
+{
+    FlushSink(byteSink);
+
+    if (byteSink.memory != nullptr)
+    {
+        byteSink.memory->insert(byteSink.memory->end(), bytes.begin(), bytes.end());
+    }
+    else if (!byteSink.discard)
+    {
+        byteSink.outputFile.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    byteSink.written += bytes.size();
+
+    if (byteSink.outputFile.fail())
+    {
+        throw std::runtime_error("Could not write compressed output");
+    }
+}
+
+void WriteHeader(ByteSink& byteSink, const ArchiveHeader& archiveHeader)
+{
+    PutByte(byteSink, 'I');
+    PutByte(byteSink, 'W');
+    PutByte(byteSink, archiveHeader.version);
+
+    for (std::size_t byteIndex = 0; byteIndex < 8; byteIndex++)
+    {
+        PutByte(byteSink, static_cast<unsigned char>(archiveHeader.originalSize >> (byteIndex * 8)));
+    }
+
+    PutByte(byteSink, archiveHeader.memoryBits);
+    PutByte(byteSink, archiveHeader.preset);
+
+    for (std::size_t byteIndex = 0; byteIndex < 8; byteIndex++)
+    {
+        PutByte(byteSink, static_cast<unsigned char>(archiveHeader.snapshotIdentity >> (byteIndex * 8)));
+    }
+
+    for (std::size_t byteIndex = 0; byteIndex < 4; byteIndex++)
+    {
+        PutByte(byteSink, static_cast<unsigned char>(archiveHeader.dictionary.size() >> (byteIndex * 8)));
+    }
+
+    for (const std::vector<unsigned char>& entry: archiveHeader.dictionary)
+    {
+        PutByte(byteSink, static_cast<unsigned char>(entry.size()));
+
+        for (unsigned char byte: entry)
+        {
+            PutByte(byteSink, byte);
+        }
+    }
+}
+
+void EncodeBit(ArithmeticEncoder& encoder, ByteSink& byteSink, unsigned char bit, std::uint32_t probability)
+{
+    const std::uint32_t middle = encoder.low + ((encoder.high - encoder.low) >> 12) * probability;
+    const std::uint32_t bitMask = 0 - static_cast<std::uint32_t>(bit);
+
+    encoder.high = (middle & bitMask) | (encoder.high & ~bitMask);
+    encoder.low = (encoder.low & bitMask) | ((middle + 1) & ~bitMask);
+
+    while (((encoder.low ^ encoder.high) & 0xFF000000) == 0)
+    {
+        PutByte(byteSink, static_cast<unsigned char>(encoder.high >> 24));
+        encoder.low <<= 8;
+        encoder.high = (encoder.high << 8) | 0xFF;
+    }
+}
+
+void OpenSource(ByteSource& byteSource, const std::string& target)
+{
+    byteSource.inputFile.open(target, std::ios::binary);
+
+    if (byteSource.inputFile.fail())
+    {
+        throw std::runtime_error("Could not read from file " + target);
+    }
+}
+
+unsigned char GetByte(ByteSource& byteSource)
+{
+    if (byteSource.position == byteSource.available)
+    {
+        const std::uint64_t readSize = std::min<std::uint64_t>(byteSource.buffer.size(), byteSource.remaining);
+
+        byteSource.inputFile.read(reinterpret_cast<char*>(byteSource.buffer.data()), static_cast<std::streamsize>(readSize));
+        byteSource.available = static_cast<std::size_t>(byteSource.inputFile.gcount());
+        byteSource.remaining -= byteSource.available;
+        byteSource.position = 0;
+
+        if (byteSource.available == 0)
+        {
+            byteSource.overrun++;
+            return 0;
+        }
+    }
+
+    return byteSource.buffer[byteSource.position++];
+}
+
+ArchiveHeader ReadHeader(ByteSource& byteSource, const std::string& target)
+{
+    ArchiveHeader archiveHeader;
+
+    const unsigned char firstMagic = GetByte(byteSource);
+    const unsigned char secondMagic = GetByte(byteSource);
+    const unsigned char version = GetByte(byteSource);
+
+    for (std::size_t byteIndex = 0; byteIndex < 8; byteIndex++)
+    {
+        archiveHeader.originalSize |= static_cast<std::uint64_t>(GetByte(byteSource)) << (byteIndex * 8);
+    }
+
+    if (firstMagic != 'I' || secondMagic != 'W' || byteSource.overrun != 0)
+    {
+        throw std::runtime_error(target + " is not an .iw archive");
+    }
+
+    if (version != archiveHeader.version)
+    {
+        throw std::runtime_error(target + " uses unsupported .iw version " + std::to_string(version));
+    }
+
+    archiveHeader.memoryBits = GetByte(byteSource);
+
+    if (archiveHeader.memoryBits < minimumMemoryBits || archiveHeader.memoryBits > maximumMemoryBits)
+    {
+        throw std::runtime_error(target + " has an invalid memory budget");
+    }
+
+    archiveHeader.preset = GetByte(byteSource);
+
+    if (archiveHeader.preset == 0 || archiveHeader.preset > presetCount)
+    {
+        throw std::runtime_error(target + " uses an unknown preset");
+    }
+
+    for (std::size_t byteIndex = 0; byteIndex < 8; byteIndex++)
+    {
+        archiveHeader.snapshotIdentity |= static_cast<std::uint64_t>(GetByte(byteSource)) << (byteIndex * 8);
+    }
+
+    std::size_t dictionaryEntries = 0;
+
+    for (std::size_t byteIndex = 0; byteIndex < 4; byteIndex++)
+    {
+        dictionaryEntries |= static_cast<std::size_t>(GetByte(byteSource)) << (byteIndex * 8);
+    }
+
+    for (std::size_t entry = 0; entry < dictionaryEntries && byteSource.overrun == 0; entry++)
+    {
+        std::vector<unsigned char> entryBytes(GetByte(byteSource));
+
+        for (unsigned char& byte: entryBytes)
+        {
+            byte = GetByte(byteSource);
+        }
+
+        archiveHeader.dictionary.push_back(entryBytes);
+    }
+
+    if (byteSource.overrun != 0)
+    {
+        throw std::runtime_error(target + " has a truncated .iw header");
+    }
+
+    return archiveHeader;
+}
+
+void StartDecoder(ArithmeticDecoder& decoder, ByteSource& byteSource)
+{
+    for (std::size_t byteIndex = 0; byteIndex < 4; byteIndex++)
+    {
+        decoder.code = (decoder.code << 8) | GetByte(byteSource);
+    }
+}
+
+unsigned char DecodeBit(ArithmeticDecoder& decoder, ByteSource& byteSource, std::uint32_t probability)
+{
+    const std::uint32_t middle = decoder.low + ((decoder.high - decoder.low) >> 12) * probability;
+    const unsigned char bit = decoder.code <= middle ? 1 : 0;
+    const std::uint32_t bitMask = 0 - static_cast<std::uint32_t>(bit);
+
+    decoder.high = (middle & bitMask) | (decoder.high & ~bitMask);
+    decoder.low = (decoder.low & bitMask) | ((middle + 1) & ~bitMask);
+
+    while (((decoder.low ^ decoder.high) & 0xFF000000) == 0)
+    {
+        decoder.low <<= 8;
+        decoder.high = (decoder.high << 8) | 0xFF;
+        decoder.code = (decoder.code << 8) | GetByte(byteSource);
+    }
+
+    return bit;
+}
+
+std::uint32_t RunProbability(const AdaptiveProbability& node)
+{
+    return std::min<std::uint32_t>(std::max<std::uint32_t>(node.probability, 1), probabilityScale - 1);
+}
+
+void EncodeRunLength(
+    ArithmeticEncoder& encoder,
+    ByteSink& byteSink,
+    std::array<AdaptiveProbability, 1 << runLengthBits>& runLengths,
+    std::size_t runLength)
+{
+    std::size_t node = 1;
+
+    for (std::size_t bitIndex = runLengthBits; bitIndex-- > 0;)
+    {
+        const unsigned char bit = static_cast<unsigned char>((runLength >> bitIndex) & 1);
+
+        EncodeBit(encoder, byteSink, bit, RunProbability(runLengths[node]));
+        Adapt(runLengths[node].probability, runLengths[node].count, bit, stateAdaptLimit);
+        node = node * 2 + bit;
+    }
+}
+
+std::size_t DecodeRunLength(
+    ArithmeticDecoder& decoder,
+    ByteSource& byteSource,
+    std::array<AdaptiveProbability, 1 << runLengthBits>& runLengths)
+{
+    std::size_t node = 1;
+
+    for (std::size_t bitIndex = 0; bitIndex < runLengthBits; bitIndex++)
+    {
+        const unsigned char bit = DecodeBit(decoder, byteSource, RunProbability(runLengths[node]));
+
+        Adapt(runLengths[node].probability, runLengths[node].count, bit, stateAdaptLimit);
+        node = node * 2 + bit;
+    }
+
+    return node - (static_cast<std::size_t>(1) << runLengthBits);
+}
+
+void FlushEncoder(ArithmeticEncoder& encoder, ByteSink& byteSink)
+{
+    for (std::size_t byteIndex = 0; byteIndex < 4; byteIndex++)
+    {
+        PutByte(byteSink, static_cast<unsigned char>(encoder.low >> 24));
+        encoder.low <<= 8;
+    }
+
+    FlushSink(byteSink);
+}
+
+void PutNumber(ByteSink& byteSink, std::uint64_t number, std::size_t byteCount)
+{
+    for (std::size_t byteIndex = 0; byteIndex < byteCount; byteIndex++)
+    {
+        PutByte(byteSink, static_cast<unsigned char>(number >> (byteIndex * 8)));
+    }
+}
+
+std::uint64_t GetNumber(ByteSource& byteSource, std::size_t byteCount)
+{
+    std::uint64_t number = 0;
+
+    for (std::size_t byteIndex = 0; byteIndex < byteCount; byteIndex++)
+    {
+        number |= static_cast<std::uint64_t>(GetByte(byteSource)) << (byteIndex * 8);
+    }
+
+    return number;
+}
+
+void WriteContainerHeader(ByteSink& byteSink, const ContainerHeader& containerHeader)
+{
+    PutByte(byteSink, 'I');
+    PutByte(byteSink, 'W');
+    PutByte(byteSink, containerHeader.version);
+    PutNumber(byteSink, containerHeader.originalSize, 8);
+    PutNumber(byteSink, containerHeader.blocks.size(), 4);
+
+    for (const BlockEntry& blockEntry: containerHeader.blocks)
+    {
+        PutNumber(byteSink, blockEntry.originalSize, 8);
+        PutNumber(byteSink, blockEntry.compressedSize, 8);
+    }
+}
+
+ContainerHeader ReadContainerHeader(ByteSource& byteSource, const std::string& target)
+{
+    ContainerHeader containerHeader;
+
+    const unsigned char firstMagic = GetByte(byteSource);
+    const unsigned char secondMagic = GetByte(byteSource);
+    const unsigned char version = GetByte(byteSource);
+    containerHeader.originalSize = GetNumber(byteSource, 8);
+    containerHeader.blocks.resize(GetNumber(byteSource, 4));
+
+    if (firstMagic != 'I' || secondMagic != 'W' || version != containerHeader.version)
+    {
+        throw std::runtime_error(target + " is not a block .iw archive");
+    }
+
+    std::uint64_t blockTotal = 0;
+
+    for (BlockEntry& blockEntry: containerHeader.blocks)
+    {
+        blockEntry.originalSize = GetNumber(byteSource, 8);
+        blockEntry.compressedSize = GetNumber(byteSource, 8);
+        blockTotal += blockEntry.originalSize;
+    }
+
+    if (byteSource.overrun != 0 || blockTotal != containerHeader.originalSize)
+    {
+        throw std::runtime_error(target + " has a corrupt block index");
+    }
+
+    return containerHeader;
+}
+
+std::size_t ContainerHeaderSize(const ContainerHeader& containerHeader)
+{
+    const std::size_t fixedSize = 3 + 8 + 4;
+    const std::size_t entrySize = 8 + 8;
+
+    return fixedSize + containerHeader.blocks.size() * entrySize;
+}
+
+std::uint8_t ArchiveVersion(const std::string& target)
+{
+    ByteSource byteSource;
+    OpenSource(byteSource, target);
+
+    const unsigned char firstMagic = GetByte(byteSource);
+    const unsigned char secondMagic = GetByte(byteSource);
+    const unsigned char version = GetByte(byteSource);
+
+    if (firstMagic != 'I' || secondMagic != 'W' || byteSource.overrun != 0)
+    {
+        throw std::runtime_error(target + " is not an .iw archive");
+    }
+
+    return version;
+}
+
+std::string GetUsage() {
+    std::string usage = "Usage: ./Compressor <command> <target> [-j <jobs>] [-b <block size>] [-m <memory>] [-p <preset>] [-t <threads>] [-s <snapshot>] [-r <start>:<length>] [-f]\n\n";
+    usage += "Commands:\n";
+    usage += "  -c --compress   Compress target\n";
+    usage += "  -d --decompress Decompress target\n";
+    usage += "  -l --learn      Train the models on target and save them to target.iws\n\n";
+    usage += "Options:\n";
+    usage += "  -j --jobs       Compress independent blocks on this many threads\n";
+    usage += "  -b --block-size Compress into seekable blocks of this many bytes\n";
+    usage += "  -m --mem        Bound model memory per block, from 1M to 1024G (default 256M)\n";
+    usage += "  -p --preset     Trade speed for ratio, from 1 (fastest) to 9 (strongest, default 6)\n";
+    usage += "  -t --threads    Run the models of each compressed stream on up to this many threads, from 1 to 4\n";
+    usage += "  -s --snapshot   Start the models from a snapshot saved by --learn\n";
+    usage += "  -r --range      Decompress only this byte range from the nearest block\n";
+    usage += "  -f --force      Overwrite an output file that already exists\n\n";
+    usage += "Examples:\n";
+    usage += "  Compress the file enwik3:\n";
+    usage += "    ./Compressor -c enwik3\n";
+    usage += "  Compress the file enwik9 on 8 threads:\n";
+    usage += "    ./Compressor -c enwik9 -j 8\n";
+    usage += "  Compress the file enwik9 with 512 MiB of model memory:\n";
+    usage += "    ./Compressor -c enwik9 --mem 512M\n";
+    usage += "  Compress the file enwik9 with the fastest preset:\n";
+    usage += "    ./Compressor -c enwik9 -p 1\n";
+    usage += "  Compress the file enwik9 with its models on 3 threads:\n";
+    usage += "    ./Compressor -c enwik9 -t 3\n";
+    usage += "  Compress the page page.xml with models learned from the file enwik8:\n";
+    usage += "    ./Compressor -l enwik8\n";
+    usage += "    ./Compressor -c page.xml -s enwik8.iws\n";
+    usage += "  Decompress the file enwik3.iw:\n";
+    usage += "    ./Compressor -d enwik3.iw\n";
+    usage += "  Decompress the file enwik3.iw over an existing enwik3:\n";
+    usage += "    ./Compressor -d enwik3.iw -f\n";
+    usage += "  Decompress 4096 bytes from offset 1000000 of enwik9.iw:\n";
+    usage += "    ./Compressor -d enwik9.iw -r 1000000:4096";
+
+    return usage;
+}
+
+Action GetAction(const std::vector<std::string>& cliArguments)
+{
+    const std::size_t actionIndex = 1;
+    const std::string actionArgument = cliArguments.at(actionIndex);
+
+    if (actionArgument == "-c" || actionArgument == "--compress")
+    {
+        return Action::Compress;
+    }
+    else if (actionArgument == "-d" || actionArgument == "--decompress")
+    {
+        return Action::Decompress;
+    }
+    else if (actionArgument == "-l" || actionArgument == "--learn")
+    {
+        return Action::Learn;
+    }
+    else
+    {
+        throw std::runtime_error(actionArgument + " is not a valid command\n\n" + GetUsage());
+    }
+}
+
+std::string GetTarget(const std::vector<std::string>& cliArguments)
+{
+    const std::size_t targetIndex = 2;
+    return cliArguments.at(targetIndex);
+}
+
+bool IsNumber(const std::string& numberArgument)
+{
+    const std::size_t maximumDigits = 19;
+
+    return !numberArgument.empty() && numberArgument.size() <= maximumDigits &&
+        std::all_of(numberArgument.begin(), numberArgument.end(), ::isdigit);
+}
+
+bool IsFlag(const std::string& optionArgument)
+{
+    return optionArgument == "-f" || optionArgument == "--force";
+}
+
+bool HasFlag(const std::vector<std::string>& cliArguments, const std::string& shortName, const std::string& longName)
+{
+    const std::size_t optionIndex = 3;
+
+    for (std::size_t index = optionIndex; index < cliArguments.size(); index += IsFlag(cliArguments.at(index)) ? 1 : 2)
+    {
+        if (cliArguments.at(index) == shortName || cliArguments.at(index) == longName)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string GetOption(const std::vector<std::string>& cliArguments, const std::string& shortName, const std::string& longName)
+{
+    const std::size_t optionIndex = 3;
+
+    for (std::size_t index = optionIndex; index + 1 < cliArguments.size(); index += IsFlag(cliArguments.at(index)) ? 1 : 2)
+    {
+        const std::string& optionArgument = cliArguments.at(index);
+
+        if (optionArgument == shortName || optionArgument == longName)
+        {
+            return cliArguments.at(index + 1);
+        }
+    }
+
+    return "";
+}
+
+std::size_t GetJobs(const std::vector<std::string>& cliArguments)
+{
+    const std::string jobsArgument = GetOption(cliArguments, "-j", "--jobs");
+
+    if (jobsArgument.empty())
+    {
+        return 1;
+    }
+
+    if (!IsNumber(jobsArgument) || std::stoull(jobsArgument) == 0)
+    {
+        throw std::runtime_error(jobsArgument + " is not a valid number of jobs\n\n" + GetUsage());
+    }
+
+    return std::stoull(jobsArgument);
+}
+
+std::size_t GetBlockSize(const std::vector<std::string>& cliArguments)
+{
+    const std::string blockSizeArgument = GetOption(cliArguments, "-b", "--block-size");
+
+    if (blockSizeArgument.empty())
+    {
+        return 0;
+    }
+
+    if (!IsNumber(blockSizeArgument) || std::stoull(blockSizeArgument) == 0)
+    {
+        throw std::runtime_error(blockSizeArgument + " is not a valid block size\n\n" + GetUsage());
+    }
+
+    return std::stoull(blockSizeArgument);
+}
+
+std::uint64_t GetMemory(const std::vector<std::string>& cliArguments)
+{
+    const std::string memoryArgument = GetOption(cliArguments, "-m", "--mem");
+
+    if (memoryArgument.empty())
+    {
+        return Command().memory;
+    }
+
+    const std::string suffixes = "KMG";
+    const std::size_t suffix = suffixes.find(memoryArgument.back());
+    const std::string digits = suffix == std::string::npos ? memoryArgument : memoryArgument.substr(0, memoryArgument.size() - 1);
+    const std::size_t shift = suffix == std::string::npos ? 0 : 10 * (suffix + 1);
+
+    if (!IsNumber(digits) || std::bit_width(std::stoull(digits)) + shift > maximumMemoryBits + 1 ||
+        std::bit_width(std::stoull(digits)) + shift <= minimumMemoryBits)
+    {
+        throw std::runtime_error(memoryArgument + " is not a valid memory budget\n\n" + GetUsage());
+    }
+
+    return std::bit_floor(static_cast<std::uint64_t>(std::stoull(digits)) << shift);
+}
+
+std::size_t GetPreset(const std::vector<std::string>& cliArguments)
+{
+    const std::string presetArgument = GetOption(cliArguments, "-p", "--preset");
+
+    if (presetArgument.empty())
+    {
+        return Command().preset;
+    }
+
+    if (!IsNumber(presetArgument) || std::stoull(presetArgument) == 0 || std::stoull(presetArgument) > presetCount)
+    {
+        throw std::runtime_error(presetArgument + " is not a valid preset\n\n" + GetUsage());
+    }
+
+    return std::stoull(presetArgument);
+}
+
+std::size_t GetModelThreads(const std::vector<std::string>& cliArguments)
+{
+    const std::size_t maximumThreads = 4;
+    const std::string threadsArgument = GetOption(cliArguments, "-t", "--threads");
+
+    if (threadsArgument.empty())
+    {
+        return Command().modelThreads;
+    }
+
+    if (GetAction(cliArguments) != Action::Compress)
+    {
+        throw std::runtime_error("-t only applies when compressing\n\n" + GetUsage());
+    }
+
+    if (!IsNumber(threadsArgument) || std::stoull(threadsArgument) == 0 || std::stoull(threadsArgument) > maximumThreads)
+    {
+        throw std::runtime_error(threadsArgument + " is not a valid number of threads\n\n" + GetUsage());
+    }
+
+    return std::stoull(threadsArgument);
+}
+
+std::string GetSnapshot(const std::vector<std::string>& cliArguments)
+{
+    return GetOption(cliArguments, "-s", "--snapshot");
+}
+
+ByteRange GetRange(const std::vector<std::string>& cliArguments)
+{
+    const std::string rangeArgument = GetOption(cliArguments, "-r", "--range");
+    ByteRange range;
+
+    if (rangeArgument.empty())
+    {
+        return range;
+    }
+
+    if (GetAction(cliArguments) != Action::Decompress)
+    {
+        throw std::runtime_error("-r only applies when decompressing\n\n" + GetUsage());
+    }
+
+    const std::size_t separator = rangeArgument.find(':');
+
+    if (separator == std::string::npos || !IsNumber(rangeArgument.substr(0, separator)) ||
+        !IsNumber(rangeArgument.substr(separator + 1)))
+    {
+        throw std::runtime_error(rangeArgument + " is not a valid byte range\n\n" + GetUsage());
+    }
+
+    range.start = std::stoull(rangeArgument.substr(0, separator));
+    range.length = std::stoull(rangeArgument.substr(separator + 1));
+
+    return range;
+}
+
+std::vector<unsigned char> ReadTarget(const std::string& target)
+{
+    std::ifstream inputFile(target, std::ios::binary | std::ios::ate);
+
+    if (inputFile.fail())
+    {
+        throw std::runtime_error("Could not read from file " + target);
+    }
+
+    std::vector<unsigned char> inputBytes(static_cast<std::size_t>(inputFile.tellg()));
+    inputFile.seekg(0);
+    inputFile.read(reinterpret_cast<char*>(inputBytes.data()), static_cast<std::streamsize>(inputBytes.size()));
+
+    if (inputFile.fail())
+    {
+        throw std::runtime_error("Could not read from file " + target);
+    }
+
+    return inputBytes;
+}
+
+void OpenInput(InputBuffer& inputBuffer, const std::string& target)
+{
+    const int descriptor = open(target.c_str(), O_RDONLY);
+
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Could not read from file " + target);
+    }
+
+    struct stat fileStatus;
+
+    if (fstat(descriptor, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode) && fileStatus.st_size > 0)
+    {
+        const std::size_t mappingSize = static_cast<std::size_t>(fileStatus.st_size);
+        void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+        if (mapping != MAP_FAILED)
+        {
+            madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+            inputBuffer.mapping = mapping;
+            inputBuffer.mappingSize = mappingSize;
+        }
+    }
+
+    close(descriptor);
+
+    if (inputBuffer.mapping == nullptr)
+    {
+        inputBuffer.ownedBytes = ReadTarget(target);
+    }
+}
+
+std::span<const unsigned char> InputBytes(const InputBuffer& inputBuffer)
+{
+    if (inputBuffer.mapping != nullptr)
+    {
+        return std::span<const unsigned char>(static_cast<const unsigned char*>(inputBuffer.mapping), inputBuffer.mappingSize);
+    }
+
+    return inputBuffer.ownedBytes;
+}
+
+bool DictionaryCandidateStart(std::span<const unsigned char> inputBytes, std::size_t position)
+{
+    return position == 0 || (!std::isalnum(inputBytes[position - 1]) && inputBytes[position - 1] != inputBytes[position]);
+}
+
+std::uint64_t CandidateHash(std::span<const unsigned char> inputBytes, std::size_t position)
+{
+    const std::uint64_t multiplier = 0x100000001B3;
+    std::uint64_t hash = 0xCBF29CE484222325;
+
+    for (std::size_t offset = 0; offset < entryLength; offset++)
+    {
+        hash = (hash ^ inputBytes[position + offset]) * multiplier;
+    }
+
+    return hash;
+}
+
+std::size_t CandidateSlot(const CandidateCounts& candidates, std::uint64_t hash, std::size_t row)
+{
+    return row * candidates.slots + (static_cast<std::size_t>(hash >> (row * 32)) & (candidates.slots - 1));
+}
+
+std::size_t CandidateCount(const CandidateCounts& candidates, std::uint64_t hash)
+{
+    std::size_t count = std::numeric_limits<std::size_t>::max();
+
+    for (std::size_t row = 0; row < candidateRows; row++)
+    {
+        count = std::min<std::size_t>(count, candidates.counts[CandidateSlot(candidates, hash, row)].load(std::memory_order_relaxed));
+    }
+
+    return count;
+}
+
+void CountCandidates(std::span<const unsigned char> inputBytes, std::size_t begin, std::size_t end, CandidateCounts& candidates)
+{
+    for (std::size_t position = begin; position < end && position + entryLength <= inputBytes.size(); position++)
+    {
+        if (!DictionaryCandidateStart(inputBytes, position))
+        {
+            continue;
+        }
+
+        const std::uint64_t hash = CandidateHash(inputBytes, position);
+
+        for (std::size_t row = 0; row < candidateRows; row++)
+        {
+            const std::size_t slot = CandidateSlot(candidates, hash, row);
+            std::atomic<std::uint64_t>& firstPosition = candidates.firstPositions[slot];
+            std::uint64_t storedPosition = firstPosition.load(std::memory_order_relaxed);
+
+            while ((storedPosition == 0 || position + 1 < storedPosition) &&
+                !firstPosition.compare_exchange_weak(storedPosition, position + 1, std::memory_order_relaxed))
+            {
+            }
+
+            candidates.counts[slot].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::vector<std::vector<unsigned char>> BuildDictionary(std::span<const unsigned char> inputBytes, std::uint64_t memory, std::size_t threads)
+{
+    const std::size_t minimumCount = 4;
+    const std::size_t bytesPerEntry = 8192;
+    const std::size_t maximumEntries = 1024;
+    const std::size_t chunkMinimum = 1 << 20;
+    const std::size_t minimumSlots = 1 << 10;
+    const std::size_t maximumSlots = 1 << 19;
+
+    const std::size_t chunks = std::max<std::size_t>(1, std::min(threads, inputBytes.size() / chunkMinimum));
+    const std::size_t chunkSize = (inputBytes.size() + chunks - 1) / chunks;
+
+    const std::uint64_t slotBytes = candidateRows * (sizeof(std::uint32_t) + sizeof(std::uint64_t));
+    const std::size_t budgetSlots = static_cast<std::size_t>(std::bit_floor(memory / 8 / slotBytes));
+    CandidateCounts candidates(std::clamp(std::min(std::bit_ceil(inputBytes.size()), budgetSlots), minimumSlots, maximumSlots));
+    std::vector<std::thread> workers;
+
+    for (std::size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        workers.emplace_back(
+            CountCandidates,
+            inputBytes,
+            chunk * chunkSize,
+            std::min(inputBytes.size(), (chunk + 1) * chunkSize),
+            std::ref(candidates));
+    }
+
+    for (std::thread& worker: workers)
+    {
+        worker.join();
+    }
+
+    std::vector<DictionaryCandidate> ranked;
+
+    for (std::size_t slot = 0; slot < candidates.counts.size(); slot++)
+    {
+        if (candidates.counts[slot].load(std::memory_order_relaxed) < minimumCount)
+        {
+            continue;
+        }
+
+        const std::size_t position = static_cast<std::size_t>(candidates.firstPositions[slot].load(std::memory_order_relaxed) - 1);
+        const std::size_t count = CandidateCount(candidates, CandidateHash(inputBytes, position));
+
+        if (count >= minimumCount)
+        {
+            ranked.push_back(DictionaryCandidate{count, position});
+        }
+    }
+
+    std::sort(ranked.begin(), ranked.end(), [](const DictionaryCandidate& first, const DictionaryCandidate& second)
+    {
+        return first.count != second.count ? first.count > second.count : first.position < second.position;
+    });
+    ranked.erase(std::unique(ranked.begin(), ranked.end(), [](const DictionaryCandidate& first, const DictionaryCandidate& second)
+    {
+        return first.position == second.position;
+    }), ranked.end());
+
+    std::vector<std::vector<unsigned char>> dictionary;
+    std::unordered_map<std::uint32_t, std::size_t> prefixes;
+
+    for (const DictionaryCandidate& candidate: ranked)
+    {
+        if (dictionary.size() >= std::min(maximumEntries, inputBytes.size() / bytesPerEntry))
+        {
+            break;
+        }
+
+        std::vector<unsigned char> entry(
+            inputBytes.begin() + static_cast<std::ptrdiff_t>(candidate.position),
+            inputBytes.begin() + static_cast<std::ptrdiff_t>(candidate.position + entryLength));
+
+        if (prefixes.contains(DictionaryPrefix(entry)))
+        {
+            continue;
+        }
+
+        prefixes[DictionaryPrefix(entry)] = dictionary.size();
+        dictionary.push_back(entry);
+    }
+
+    return dictionary;
+}
+
+std::shared_ptr<InputBuffer> OpenSnapshot(const std::string& target)
+{
+    std::shared_ptr<InputBuffer> snapshot = std::make_shared<InputBuffer>();
+    const int descriptor = open(target.c_str(), O_RDONLY);
+
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Could not read from file " + target);
+    }
+
+    struct stat fileStatus;
+
+    if (fstat(descriptor, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode) &&
+        static_cast<std::size_t>(fileStatus.st_size) >= sizeof(SnapshotHeader))
+    {
+        const std::size_t mappingSize = static_cast<std::size_t>(fileStatus.st_size);
+        void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+
+        if (mapping != MAP_FAILED)
+        {
+            snapshot->mapping = mapping;
+            snapshot->mappingSize = mappingSize;
+        }
+    }
+
+    close(descriptor);
+
+    if (snapshot->mapping == nullptr || SnapshotHeader().magic != static_cast<const SnapshotHeader*>(snapshot->mapping)->magic)
+    {
+        throw std::runtime_error(target + " is not an .iws snapshot");
+    }
+
+    const std::uint32_t version = static_cast<const SnapshotHeader*>(snapshot->mapping)->version;
+
+    if (version != SnapshotHeader().version)
+    {
+        throw std::runtime_error(target + " uses unsupported .iws version " + std::to_string(version));
+    }
+
+    return snapshot;
+}
+
+const SnapshotHeader& SnapshotHeaderOf(const InputBuffer& snapshot)
+{
+    return *static_cast<const SnapshotHeader*>(snapshot.mapping);
+}
+
+template <typename Value>
+std::span<Value> SnapshotValues(const InputBuffer& snapshot, const SnapshotSection& section)
+{
+    if (section.offset % alignof(Value) != 0 || section.size % sizeof(Value) != 0 || section.offset > snapshot.mappingSize ||
+        section.size > snapshot.mappingSize - section.offset)
+    {
+        throw std::runtime_error("Snapshot section lies outside the snapshot");
+    }
+
+    return std::span<Value>(reinterpret_cast<Value*>(static_cast<unsigned char*>(snapshot.mapping) + section.offset),
+        section.size / sizeof(Value));
+}
+
+template <typename Value>
+void CopySnapshot(const InputBuffer& snapshot, const SnapshotSection& section, std::span<Value> values)
+{
+    const std::span<Value> storedValues = SnapshotValues<Value>(snapshot, section);
+
+    if (storedValues.size() != values.size())
+    {
+        throw std::runtime_error("Snapshot was learned with a different model layout");
+    }
+
+    std::copy(storedValues.begin(), storedValues.end(), values.begin());
+}
+
+void MapContextTable(ContextTable& contextTable, const InputBuffer& snapshot, const SnapshotModel& snapshotModel)
+{
+    const std::span<ContextBucket> buckets = SnapshotValues<ContextBucket>(snapshot, snapshotModel.table);
+
+    if (!std::has_single_bit(buckets.size()))
+    {
+        throw std::runtime_error("Snapshot table size is not a power of two");
+    }
+
+    contextTable.ownedBuckets = std::vector<ContextBucket>();
+    contextTable.buckets = buckets;
+    contextTable.used = static_cast<std::size_t>(snapshotModel.used);
+    contextTable.evictions = static_cast<std::size_t>(snapshotModel.evictions);
+}
+
+void MapProbabilityMap(ProbabilityMap& probabilityMap, const InputBuffer& snapshot, const SnapshotSection& section)
+{
+    const std::span<AdaptiveProbability> cells = SnapshotValues<AdaptiveProbability>(snapshot, section);
+
+    if (cells.size() != probabilityMap.contexts * mapBuckets)
+    {
+        throw std::runtime_error("Snapshot was learned with a different model layout");
+    }
+
+    probabilityMap.ownedCells = std::vector<AdaptiveProbability>();
+    probabilityMap.cells = cells;
+}
+
+void PrimeModels(Predictor& predictor, const InputBuffer& snapshot)
+{
+    const SnapshotHeader& snapshotHeader = SnapshotHeaderOf(snapshot);
+
+    for (PredictionModel& predictionModel: predictor.predictionModels)
+    {
+        if (!predictionModel.active)
+        {
+            continue;
+        }
+
+        const SnapshotModel& snapshotModel = snapshotHeader.models[predictionModel.model];
+        History& history = predictionModel.history;
+
+        CopySnapshot(snapshot, snapshotModel.stateMap, std::span(history.stateMap));
+
+        CopySnapshot(snapshot, snapshotModel.performance, std::span<Performance>(history.performance));
+
+        if (predictionModel.model == Model::Distance)
+        {
+            CopySnapshot(snapshot, snapshotModel.bucketPerformance, std::span(history.match.lengthPerformance));
+        }
+        else if (predictionModel.model == Model::FutureDictionary)
+        {
+            CopySnapshot(snapshot, snapshotModel.bucketPerformance, std::span(history.dictionary.offsetPerformance));
+        }
+    }
+
+    CopySnapshot(snapshot, snapshotHeader.mixerWeights, std::span(predictor.mixer.weights));
+
+    for (std::size_t map = 0; map < mapCount; map++)
+    {
+        MapProbabilityMap(predictor.probabilityMaps[map], snapshot, snapshotHeader.probabilityMaps[map]);
+    }
+
+    CopySnapshot(snapshot, snapshotHeader.runLengths, std::span<AdaptiveProbability>(predictor.runLengths));
+}
+
+Predictor CreatePredictor(const Operation& operation, const ArchiveHeader& archiveHeader, std::span<const Model> hostedModels)
+{
+    OperationStatus operationStatus;
+    operationStatus.operation = operation;
+
+    Predictor predictor;
+    predictor.operationStatus = operationStatus;
+
+    const PresetLevels& presetLevels = PresetFor(archiveHeader.preset);
+    predictor.runMinimumMatch = presetLevels.runMinimumMatch;
+
+    WithPipeline(archiveHeader.preset, [&predictor, &presetLevels](auto pipeline)
+    {
+        for (Model model: decltype(pipeline)::modelList)
+        {
+            const std::size_t levels = model == Model::Statistics ? presetLevels.statisticsLevels :
+                model == Model::HistoricDictionary ? presetLevels.historicLevels : 1;
+            predictor.predictionModels[model] = PredictionModel(model, levels);
+        }
+    });
+
+    const std::array<PredictionModel, modelCount>& predictionModels = predictor.predictionModels;
+    predictor.prefetch = operation.command.prefetch;
+
+    const std::uint64_t memory = static_cast<std::uint64_t>(1) << archiveHeader.memoryBits;
+    const std::uint64_t inputSlots = std::bit_ceil(std::max<std::uint64_t>(archiveHeader.originalSize, 1 << 12));
+    const std::size_t tableSlots = static_cast<std::size_t>(std::min<std::uint64_t>((memory >> presetLevels.tableShift) / sizeof(ContextSlot), inputSlots));
+    const std::size_t matchSlots = static_cast<std::size_t>(std::min<std::uint64_t>(1 << 18, memory / 16 / sizeof(std::uint32_t)));
+    const std::uint64_t mapMemory = memory / 8;
+
+    predictor.byteHistory.capacity = static_cast<std::size_t>(std::min<std::uint64_t>(predictor.byteHistory.capacity, memory / 4));
+    predictor.byteHistory.window.reserve(std::min<std::uint64_t>(predictor.byteHistory.capacity, archiveHeader.originalSize));
+
+    const auto hosts = [&predictionModels, hostedModels](Model model)
+    {
+        return predictionModels[model].active && std::find(hostedModels.begin(), hostedModels.end(), model) != hostedModels.end();
+    };
+
+    if (archiveHeader.snapshotIdentity != 0)
+    {
+        if (operation.command.snapshot.empty())
+        {
+            throw std::runtime_error("This stream was compressed from a snapshot; pass it with -s");
+        }
+
+        predictor.snapshot = OpenSnapshot(operation.command.snapshot);
+        const SnapshotHeader& snapshotHeader = SnapshotHeaderOf(*predictor.snapshot);
+
+        if (snapshotHeader.identity != archiveHeader.snapshotIdentity || snapshotHeader.preset != archiveHeader.preset ||
+            snapshotHeader.memoryBits != archiveHeader.memoryBits)
+        {
+            throw std::runtime_error(operation.command.snapshot + " is not the snapshot this stream was compressed from");
+        }
+    }
+
+    for (Model model: {Model::Statistics, Model::HistoricDictionary})
+    {
+        if (hosts(model))
+        {
+            if (predictor.snapshot != nullptr)
+            {
+                MapContextTable(predictor.predictionModels[model].history.historicData, *predictor.snapshot,
+                    SnapshotHeaderOf(*predictor.snapshot).models[model]);
+            }
+            else
+            {
+                InitializeContextTable(predictor.predictionModels[model].history.historicData, tableSlots);
+            }
+
+            SelectSlots(predictor.predictionModels[model], predictor.bitHistory.recentBits, 0);
+        }
+    }
+
+    if (hosts(Model::Distance))
+    {
+        predictor.predictionModels[Model::Distance].history.match.positions.resize(matchSlots);
+    }
+
+    if (hosts(Model::FutureDictionary))
+    {
+        IndexDictionary(predictor.predictionModels[Model::FutureDictionary].history.dictionary, archiveHeader.dictionary);
+    }
+
+    const std::size_t mixerContexts = 32;
+    const std::size_t mixerInputs = VotingLevels(predictionModels[Model::Statistics].levels).size() +
+        VotingLevels(predictionModels[Model::HistoricDictionary].levels).size() + 3;
+
+    InitializeMixer(predictor.mixer, mixerInputs, mixerContexts);
+    const std::array<std::size_t, mapCount> mapContexts = MapContextCounts(mapMemory);
+
+    for (std::size_t map = 0; map < mapCount; map++)
+    {
+        if (predictor.snapshot != nullptr)
+        {
+            predictor.probabilityMaps[map].contexts = mapContexts[map];
+        }
+        else
+        {
+            InitializeProbabilityMap(predictor.probabilityMaps[map], mapContexts[map]);
+        }
+    }
+
+    if (predictor.snapshot != nullptr)
+    {
+        PrimeModels(predictor, *predictor.snapshot);
+    }
+
+    return predictor;
+}
+
+Predictor CreatePredictor(const Operation& operation, const ArchiveHeader& archiveHeader)
+{
+    return CreatePredictor(operation, archiveHeader, FullPipeline::modelList);
+}
+
+void Prefetch(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    static_cast<void>(address);
+#endif
+}
+
+void PrefetchModelSlots(const PredictionModel& predictionModel, std::uint64_t recentBits, std::size_t nibbleStart)
+{
+    const ContextTable& contextTable = predictionModel.history.historicData;
+
+    for (std::size_t row = 0; VotingLevel(row) <= predictionModel.levels; row++)
+    {
+        const std::size_t level = VotingLevel(row);
+
+        if (!HasContext(predictionModel, level, nibbleStart))
+        {
+            break;
+        }
+
+        for (std::uint64_t bit = 0; bit < 2; bit++)
+        {
+            const std::uint64_t key = NibbleKey(predictionModel, level, (recentBits << 1) | bit, nibbleStart);
+            Prefetch(&contextTable.buckets[BucketIndex(contextTable, ContextHash(key))]);
+        }
+    }
+}
+
+template <typename Pipeline = FullPipeline>
+void PrefetchNextSlots(const Predictor& predictor)
+{
+    const std::size_t virtualPosition = predictor.operationStatus.position.virtualPosition;
+    const ByteHistory& byteHistory = predictor.byteHistory;
+
+    if (!predictor.prefetch || virtualPosition % nibbleBits != nibbleBits - 1)
+    {
+        return;
+    }
+
+    if constexpr (Pipeline::Contains(Model::Statistics))
+    {
+        PrefetchModelSlots(predictor.predictionModels[Model::Statistics], predictor.bitHistory.recentBits, virtualPosition + 1);
+    }
+
+    if constexpr (Pipeline::Contains(Model::HistoricDictionary))
+    {
+        PrefetchModelSlots(predictor.predictionModels[Model::HistoricDictionary], predictor.bitHistory.recentBits, virtualPosition + 1);
+    }
+
+    if (!Pipeline::Contains(Model::Distance) || virtualPosition % 8 != 7 || byteHistory.length + 1 < matchMinimum)
+    {
+        return;
+    }
+
+    const std::vector<std::uint32_t>& positions = predictor.predictionModels[Model::Distance].history.match.positions;
+    const std::uint64_t recentBytes = RecentBytes(byteHistory, matchMinimum - 1) << 8;
+
+    for (std::uint32_t bit = 0; bit < 2 && !positions.empty(); bit++)
+    {
+        const std::uint64_t nextByte = ((byteHistory.partialByte << 1) | bit) & 0xFF;
+        Prefetch(&positions[MatchIndex(recentBytes | nextByte, positions.size())]);
+    }
+}
+
+template <typename Pipeline>
+void RecordByte(Predictor& predictor)
+{
+    if (Pipeline::Contains(Model::Distance) && predictor.byteHistory.partialByte == 1)
+    {
+        const std::chrono::steady_clock::time_point modelStart = StartModelClock();
+        RecordMatch(predictor);
+        StopModelClock(predictor.predictionModels.at(Model::Distance).elapsed, modelStart);
+    }
+
+    if (Pipeline::Contains(Model::FutureDictionary) && predictor.byteHistory.partialByte == 1)
+    {
+        const std::chrono::steady_clock::time_point modelStart = StartModelClock();
+        RecordDictionary(predictor);
+        StopModelClock(predictor.predictionModels.at(Model::FutureDictionary).elapsed, modelStart);
+    }
+}
+
+template <typename Pipeline = FullPipeline>
+void UpdateModels(Predictor& predictor, const Guess& guess, unsigned char bit)
+{
+    RecordModelPerformance<Pipeline>(predictor, guess, bit);
+    RecordHistory<Pipeline>(predictor, bit);
+    AdvancePosition(predictor, bit);
+    SelectPredictorSlots<Pipeline>(predictor);
+    RecordByte<Pipeline>(predictor);
+    PrefetchNextSlots<Pipeline>(predictor);
+}
+
+template <typename Pipeline = FullPipeline>
+void UpdatePredictor(Predictor& predictor, const Guess& guess, unsigned char bit)
+{
+    RecordMixer(predictor, guess, bit);
+    RecordProbabilityMaps(predictor, guess, bit);
+    UpdateModels<Pipeline>(predictor, guess, bit);
+}
+
+template <typename Pipeline = FullPipeline>
+void SkipBit(Predictor& predictor, unsigned char bit)
+{
+    if constexpr (Pipeline::Contains(Model::Distance))
+    {
+        RecordDistance(predictor, bit);
+    }
+
+    if constexpr (Pipeline::Contains(Model::FutureDictionary))
+    {
+        RecordFuture(predictor, bit);
+    }
+
+    AdvancePosition(predictor, bit);
+    RecordByte<Pipeline>(predictor);
+}
+
+template <typename Pipeline = FullPipeline>
+std::size_t SkipRun(Predictor& predictor, const RunGuess& runGuess, std::size_t runLength)
+{
+    const std::size_t skippedBits = runLength < runGuess.length ? runLength + 1 : runLength;
+
+    for (std::size_t bitIndex = 0; bitIndex < skippedBits; bitIndex++)
+    {
+        SkipBit<Pipeline>(predictor, RunBit(runGuess, bitIndex) ^ (bitIndex == runLength ? 1 : 0));
+    }
+
+    return skippedBits;
+}
+
+template <typename Pipeline>
+void EncodeBits(
+    std::span<const unsigned char> inputBytes,
+    Predictor& predictor,
+    ArithmeticEncoder& encoder,
+    ByteSink& byteSink,
+    CodingReport& codingReport)
+{
+    const std::size_t numberBits = 8;
+    GuessResult guessResult;
+
+    for (std::size_t bitPosition = 0; bitPosition < inputBytes.size() * numberBits; bitPosition++)
+    {
+        const RunGuess runGuess = GuessBits<Pipeline>(predictor, inputBytes.size() - bitPosition / numberBits);
+
+        if (runGuess.length > 0)
+        {
+            const std::size_t runLength = CheckGuess(runGuess, InputWord(inputBytes, bitPosition / numberBits, runGuess.length));
+
+            EncodeRunLength(encoder, byteSink, predictor.runLengths, runLength);
+            bitPosition += SkipRun<Pipeline>(predictor, runGuess, runLength) - 1;
+            codingReport.correctBits += runLength;
+            continue;
+        }
+
+        const unsigned char bit = GetBitFromInput(inputBytes, bitPosition);
+
+        MakeGuess<Pipeline>(predictor, bit, guessResult);
+        EncodeBit(encoder, byteSink, bit, GuessProbability(guessResult.guess));
+        UpdatePredictor<Pipeline>(predictor, guessResult.guess, bit);
+
+        if (guessResult.correct)
+        {
+            codingReport.correctBits++;
+        }
+    }
+}
+
+void PutDecodedBytes(const Predictor& predictor, ByteSink& byteSink, const ByteRange& range, std::uint64_t& writtenBytes)
+{
+    const ByteHistory& byteHistory = predictor.byteHistory;
+
+    for (; writtenBytes < std::min<std::uint64_t>(byteHistory.length, range.start + range.length); writtenBytes++)
+    {
+        if (writtenBytes >= range.start)
+        {
+            PutByte(byteSink, WindowByte(byteHistory, writtenBytes));
+        }
+    }
+}
+
+template <typename Pipeline>
+void DecodeBytes(
+    Predictor& predictor,
+    ArithmeticDecoder& decoder,
+    ByteSource& byteSource,
+    ByteSink& byteSink,
+    const ByteRange& range,
+    std::uint64_t originalSize,
+    CodingReport& codingReport)
+{
+    const std::size_t numberBits = 8;
+    const std::vector<unsigned char> guessedBits;
+    Guess guess;
+    std::uint64_t writtenBytes = 0;
+
+    for (std::uint64_t bitPosition = 0; bitPosition < (range.start + range.length) * numberBits; bitPosition++)
+    {
+        if (byteSource.overrun != 0)
+        {
+            throw std::runtime_error(predictor.operationStatus.operation.command.target + " is truncated or corrupt");
+        }
+
+        const RunGuess runGuess = GuessBits<Pipeline>(predictor, originalSize - bitPosition / numberBits);
+
+        if (runGuess.length > 0)
+        {
+            const std::size_t runLength = DecodeRunLength(decoder, byteSource, predictor.runLengths);
+
+            bitPosition += SkipRun<Pipeline>(predictor, runGuess, runLength) - 1;
+            codingReport.correctBits += runLength;
+            PutDecodedBytes(predictor, byteSink, range, writtenBytes);
+            continue;
+        }
+
+        GuessBit<Pipeline>(predictor, guessedBits, guess);
+        const unsigned char bit = DecodeBit(decoder, byteSource, GuessProbability(guess));
+
+        if (CheckGuess(guess, bit))
+        {
+            codingReport.correctBits++;
+        }
+
+        UpdatePredictor<Pipeline>(predictor, guess, bit);
+        PutDecodedBytes(predictor, byteSink, range, writtenBytes);
+    }
+}
+
+bool PushVotes(VoteRing& voteRing, const Guess& guess)
+{
+    const std::size_t written = voteRing.written.load(std::memory_order_relaxed);
+
+    while (written - voteRing.readSeen == voteRing.frames.size())
+    {
+        if (voteRing.stopped.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+
+        std::this_thread::yield();
+        voteRing.readSeen = voteRing.read.load(std::memory_order_acquire);
+    }
+
+    VoteFrame& voteFrame = voteRing.frames[written % voteRing.frames.size()];
+
+    std::copy(guess.statisticsVotes.begin(), guess.statisticsVotes.end(), voteFrame.statisticsVotes.begin());
+    std::copy(guess.historicVotes.begin(), guess.historicVotes.end(), voteFrame.historicVotes.begin());
+    voteFrame.statisticsCount = static_cast<std::uint8_t>(guess.statisticsVotes.size());
+    voteFrame.historicCount = static_cast<std::uint8_t>(guess.historicVotes.size());
+    voteRing.written.store(written + 1, std::memory_order_release);
+
+    return true;
+}
+
+void PopVotes(VoteRing& voteRing, Guess& guess)
+{
+    const std::size_t read = voteRing.read.load(std::memory_order_relaxed);
+
+    while (read == voteRing.writtenSeen)
+    {
+        if (voteRing.stopped.load(std::memory_order_acquire))
+        {
+            throw std::runtime_error("Model thread stopped before the end of the stream");
+        }
+
+        std::this_thread::yield();
+        voteRing.writtenSeen = voteRing.written.load(std::memory_order_acquire);
+    }
+
+    const VoteFrame& voteFrame = voteRing.frames[read % voteRing.frames.size()];
+
+    guess.statisticsVotes.insert(guess.statisticsVotes.end(), voteFrame.statisticsVotes.begin(),
+        voteFrame.statisticsVotes.begin() + voteFrame.statisticsCount);
+    guess.historicVotes.insert(guess.historicVotes.end(), voteFrame.historicVotes.begin(),
+        voteFrame.historicVotes.begin() + voteFrame.historicCount);
+    voteRing.read.store(read + 1, std::memory_order_release);
+}
+
+std::vector<std::size_t> AvailableCores()
+{
+    std::vector<std::size_t> availableCores;
+#ifdef __linux__
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+
+    if (sched_getaffinity(0, sizeof(cores), &cores) == 0)
+    {
+        for (std::size_t core = 0; core < CPU_SETSIZE; core++)
+        {
+            if (CPU_ISSET(core, &cores))
+            {
+                availableCores.push_back(core);
+            }
+        }
+    }
+#endif
+
+    return availableCores;
+}
+
+bool SetAffinity(pthread_t thread, std::span<const std::size_t> allowedCores)
+{
+#ifdef __linux__
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+
+    for (const std::size_t core: allowedCores)
+    {
+        CPU_SET(core, &cores);
+    }
+
+    return pthread_setaffinity_np(thread, sizeof(cores), &cores) == 0;
+#else
+    static_cast<void>(thread);
+    static_cast<void>(allowedCores);
+
+    return false;
+#endif
+}
+
+bool PinModelThreads(std::vector<std::thread>& workers, const std::vector<std::size_t>& availableCores)
+{
+    if (availableCores.size() <= workers.size() || !SetAffinity(pthread_self(), std::span(availableCores).first(1)))
+    {
+        return false;
+    }
+
+    for (std::size_t worker = 0; worker < workers.size(); worker++)
+    {
+        if (!SetAffinity(workers[worker].native_handle(), std::span(availableCores).subspan(worker + 1, 1)))
+        {
+            for (std::size_t pinnedWorker = 0; pinnedWorker < worker; pinnedWorker++)
+            {
+                SetAffinity(workers[pinnedWorker].native_handle(), availableCores);
+            }
+
+            SetAffinity(pthread_self(), availableCores);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename WorkerPipeline>
+void RunModelWorker(std::span<const unsigned char> inputBytes, Predictor& predictor, VoteRing& voteRing)
+{
+    const std::size_t numberBits = 8;
+    const std::vector<unsigned char> guessedBits;
+    Guess guess;
+
+    for (std::size_t bitPosition = 0; bitPosition < inputBytes.size() * numberBits; bitPosition++)
+    {
+        const RunGuess runGuess = GuessBits<WorkerPipeline>(predictor, inputBytes.size() - bitPosition / numberBits);
+
+        if (runGuess.length > 0)
+        {
+            const std::size_t runLength = CheckGuess(runGuess, InputWord(inputBytes, bitPosition / numberBits, runGuess.length));
+
+            bitPosition += SkipRun<WorkerPipeline>(predictor, runGuess, runLength) - 1;
+            continue;
+        }
+
+        GuessModels<WorkerPipeline>(predictor, guessedBits, guess);
+
+        if (!PushVotes(voteRing, guess))
+        {
+            return;
+        }
+
+        UpdateModels<WorkerPipeline>(predictor, guess, GetBitFromInput(inputBytes, bitPosition));
+    }
+}
+
+template <typename CoderPipeline>
+void EncodeVotes(
+    std::span<const unsigned char> inputBytes,
+    Predictor& predictor,
+    std::deque<VoteRing>& voteRings,
+    ArithmeticEncoder& encoder,
+    ByteSink& byteSink,
+    CodingReport& codingReport)
+{
+    const std::size_t numberBits = 8;
+    const std::vector<unsigned char> guessedBits;
+    Guess guess;
+
+    for (std::size_t bitPosition = 0; bitPosition < inputBytes.size() * numberBits; bitPosition++)
+    {
+        const RunGuess runGuess = GuessBits<CoderPipeline>(predictor, inputBytes.size() - bitPosition / numberBits);
+
+        if (runGuess.length > 0)
+        {
+            const std::size_t runLength = CheckGuess(runGuess, InputWord(inputBytes, bitPosition / numberBits, runGuess.length));
+
+            EncodeRunLength(encoder, byteSink, predictor.runLengths, runLength);
+            bitPosition += SkipRun<CoderPipeline>(predictor, runGuess, runLength) - 1;
+            codingReport.correctBits += runLength;
+            continue;
+        }
+
+        const unsigned char bit = GetBitFromInput(inputBytes, bitPosition);
+
+        GuessModels<CoderPipeline>(predictor, guessedBits, guess);
+
+        for (VoteRing& voteRing: voteRings)
+        {
+            PopVotes(voteRing, guess);
+        }
+
+        MixVotes(predictor, guessedBits, guess);
+        EncodeBit(encoder, byteSink, bit, GuessProbability(guess));
+        UpdatePredictor<CoderPipeline>(predictor, guess, bit);
+
+        if (CheckGuess(guess, bit))
+        {
+            codingReport.correctBits++;
+        }
+    }
+}
+
+template <typename WorkerPipeline>
+void StartModelWorker(
+    const Operation& operation,
+    const ArchiveHeader& archiveHeader,
+    std::deque<Predictor>& workerPredictors,
+    std::deque<VoteRing>& voteRings,
+    std::vector<std::thread>& workers)
+{
+    Predictor& workerPredictor = workerPredictors.emplace_back(CreatePredictor(operation, archiveHeader, WorkerPipeline::modelList));
+    VoteRing& voteRing = voteRings.emplace_back();
+
+    workerPredictor.probabilityMaps = {};
+
+    workers.emplace_back([&operation, &workerPredictor, &voteRing]()
+    {
+        try
+        {
+            RunModelWorker<WorkerPipeline>(operation.inputBytes, workerPredictor, voteRing);
+        }
+        catch (...)
+        {
+            voteRing.failure = std::current_exception();
+            voteRing.stopped.store(true, std::memory_order_release);
+        }
+    });
+}
+
+template <typename Pipeline>
+Predictor EncodeThreaded(const Operation& operation, const ArchiveHeader& archiveHeader, ArithmeticEncoder& encoder, ByteSink& byteSink, CodingReport& codingReport)
+{
+    using CoderPipeline = RunPipeline<Pipeline>;
+
+    const PresetLevels& presetLevels = PresetFor(archiveHeader.preset);
+
+    if (VotingLevels(std::max(presetLevels.statisticsLevels, presetLevels.historicLevels)).size() > frameVotes)
+    {
+        throw std::runtime_error("Preset " + std::to_string(archiveHeader.preset) + " votes on more levels than a model thread carries");
+    }
+
+    Predictor predictor = CreatePredictor(operation, archiveHeader, CoderPipeline::modelList);
+    std::deque<Predictor> workerPredictors;
+    std::deque<VoteRing> voteRings;
+    std::vector<std::thread> workers;
+    std::exception_ptr failure;
+    const std::vector<std::size_t> availableCores = AvailableCores();
+    bool pinned = false;
+
+    try
+    {
+        if constexpr (!Pipeline::Contains(Model::HistoricDictionary))
+        {
+            StartModelWorker<FastPipeline>(operation, archiveHeader, workerPredictors, voteRings, workers);
+        }
+        else if (operation.command.modelThreads == 2)
+        {
+            StartModelWorker<RunPipeline<Pipeline, Model::Statistics, Model::HistoricDictionary>>(operation, archiveHeader, workerPredictors, voteRings, workers);
+        }
+        else
+        {
+            StartModelWorker<RunPipeline<Pipeline, Model::Statistics>>(operation, archiveHeader, workerPredictors, voteRings, workers);
+            StartModelWorker<RunPipeline<Pipeline, Model::HistoricDictionary>>(operation, archiveHeader, workerPredictors, voteRings, workers);
+        }
+
+        pinned = operation.command.jobs == 1 && PinModelThreads(workers, availableCores);
+        EncodeVotes<CoderPipeline>(operation.inputBytes, predictor, voteRings, encoder, byteSink, codingReport);
+    }
+    catch (...)
+    {
+        failure = std::current_exception();
+    }
+
+    for (VoteRing& voteRing: voteRings)
+    {
+        voteRing.stopped.store(true, std::memory_order_release);
+    }
+
+    for (std::thread& worker: workers)
+    {
+        worker.join();
+    }
+
+    if (pinned)
+    {
+        SetAffinity(pthread_self(), availableCores);
+    }
+
+    for (const VoteRing& voteRing: voteRings)
+    {
+        if (voteRing.failure)
+        {
+            std::rethrow_exception(voteRing.failure);
+        }
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+
+    for (const Predictor& workerPredictor: workerPredictors)
+    {
+        for (Model model: {Model::Statistics, Model::HistoricDictionary})
+        {
+            predictor.predictionModels[model].elapsed += workerPredictor.predictionModels[model].elapsed;
+        }
+    }
+
+    return predictor;
+}
+
+ArchiveHeader StreamHeader(const Operation& operation, CodingReport& codingReport)
+{
+    ArchiveHeader archiveHeader;
+    archiveHeader.originalSize = operation.inputBytes.size();
+    archiveHeader.memoryBits = static_cast<std::uint8_t>(std::bit_width(operation.command.memory) - 1);
+    archiveHeader.preset = static_cast<std::uint8_t>(operation.command.preset);
+
+    if (!operation.command.snapshot.empty())
+    {
+        const SnapshotHeader snapshotHeader = SnapshotHeaderOf(*OpenSnapshot(operation.command.snapshot));
+
+        if (snapshotHeader.memoryBits < minimumMemoryBits || snapshotHeader.memoryBits > maximumMemoryBits ||
+            snapshotHeader.preset == 0 || snapshotHeader.preset > presetCount || snapshotHeader.identity == 0)
+        {
+            throw std::runtime_error(operation.command.snapshot + " has an invalid snapshot header");
+        }
+
+        if (operation.command.explicitMemory && snapshotHeader.memoryBits != archiveHeader.memoryBits)
+        {
+            throw std::runtime_error(operation.command.snapshot + " was learned with " +
+                                     std::to_string(static_cast<std::uint64_t>(1) << snapshotHeader.memoryBits) +
+                                     " bytes of model memory, drop -m or learn it again");
+        }
+
+        if (operation.command.explicitPreset && snapshotHeader.preset != archiveHeader.preset)
+        {
+            throw std::runtime_error(operation.command.snapshot + " was learned with preset " +
+                                     std::to_string(snapshotHeader.preset) + ", drop -p or learn it again");
+        }
+
+        archiveHeader.memoryBits = static_cast<std::uint8_t>(snapshotHeader.memoryBits);
+        archiveHeader.preset = static_cast<std::uint8_t>(snapshotHeader.preset);
+        archiveHeader.snapshotIdentity = snapshotHeader.identity;
+    }
+
+    if (WithPipeline(archiveHeader.preset, [](auto pipeline) { return decltype(pipeline)::Contains(Model::FutureDictionary); }))
+    {
+        std::chrono::steady_clock::time_point dictionaryStart = std::chrono::steady_clock::now();
+        const std::size_t dictionaryThreads =
+            std::max<std::size_t>(1, std::thread::hardware_concurrency() / std::max<std::size_t>(1, operation.command.jobs));
+        archiveHeader.dictionary =
+            BuildDictionary(operation.inputBytes, static_cast<std::uint64_t>(1) << archiveHeader.memoryBits, dictionaryThreads);
+        codingReport.dictionarySeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - dictionaryStart).count();
+        codingReport.dictionaryEntries = archiveHeader.dictionary.size();
+    }
+
+    return archiveHeader;
+}
+
+CodingReport CompressStream(const Operation& operation, ByteSink& byteSink)
+{
+    CodingReport codingReport;
+    codingReport.inputSize = operation.inputBytes.size();
+
+    const ArchiveHeader archiveHeader = StreamHeader(operation, codingReport);
+
+    WriteHeader(byteSink, archiveHeader);
+
+    ArithmeticEncoder encoder;
+
+    Predictor predictor = WithPipeline(archiveHeader.preset, [&operation, &archiveHeader, &encoder, &byteSink, &codingReport](auto pipeline)
+    {
+        if (operation.command.modelThreads > 1)
+        {
+            return EncodeThreaded<decltype(pipeline)>(operation, archiveHeader, encoder, byteSink, codingReport);
+        }
+
+        Predictor predictor = CreatePredictor(operation, archiveHeader);
+        EncodeBits<decltype(pipeline)>(operation.inputBytes, predictor, encoder, byteSink, codingReport);
+
+        return predictor;
+    });
+
+    FlushEncoder(encoder, byteSink);
+    codingReport.outputSize = byteSink.written;
+    codingReport.modelSeconds = ModelSeconds(predictor);
+
+    return codingReport;
+}
+
+CodingReport DecompressStream(const Operation& operation, ByteSource& byteSource, ByteSink& byteSink, const ByteRange& range)
+{
+    const ArchiveHeader archiveHeader = ReadHeader(byteSource, operation.command.target);
+
+    Operation decodeOperation;
+    decodeOperation.command = operation.command;
+
+    Predictor predictor = CreatePredictor(decodeOperation, archiveHeader);
+    CodingReport codingReport;
+    codingReport.inputSize = archiveHeader.originalSize;
+    codingReport.dictionaryEntries = archiveHeader.dictionary.size();
+
+    ArithmeticDecoder decoder;
+    StartDecoder(decoder, byteSource);
+
+    ByteRange decodeRange;
+    decodeRange.start = std::min(range.start, archiveHeader.originalSize);
+    decodeRange.length = std::min(range.length, archiveHeader.originalSize - decodeRange.start);
+
+    WithPipeline(archiveHeader.preset, [&predictor, &decoder, &byteSource, &byteSink, &decodeRange, &archiveHeader, &codingReport](auto pipeline)
+    {
+        DecodeBytes<decltype(pipeline)>(predictor, decoder, byteSource, byteSink, decodeRange, archiveHeader.originalSize, codingReport);
+    });
+
+    if (decodeRange.start + decodeRange.length == archiveHeader.originalSize)
+    {
+        GetByte(byteSource);
+
+        if (byteSource.overrun != 1)
+        {
+            throw std::runtime_error(operation.command.target + " is truncated or corrupt");
+        }
+    }
+
+    FlushSink(byteSink);
+    codingReport.outputSize = byteSink.written;
+    codingReport.modelSeconds = ModelSeconds(predictor);
+
+    return codingReport;
+}
+
+std::uint64_t SnapshotHash(std::span<const std::byte> bytes, std::uint64_t hash)
+{
+    const std::uint64_t prime = 0x100000001B3;
+
+    for (std::byte byte: bytes)
+    {
+        hash = (hash ^ static_cast<std::uint64_t>(byte)) * prime;
+    }
+
+    return hash;
+}
+
+std::uint64_t WriteSnapshot(const Predictor& predictor, const ArchiveHeader& archiveHeader, const std::string& target)
+{
+    const std::uint64_t sectionAlignment = 64;
+    const std::uint64_t hashBasis = 0xCBF29CE484222325;
+
+    SnapshotHeader snapshotHeader;
+    snapshotHeader.memoryBits = archiveHeader.memoryBits;
+    snapshotHeader.preset = archiveHeader.preset;
+
+    std::vector<std::pair<SnapshotSection*, std::span<const std::byte>>> sections;
+
+    for (const PredictionModel& predictionModel: predictor.predictionModels)
+    {
+        if (!predictionModel.active)
+        {
+            continue;
+        }
+
+        const History& history = predictionModel.history;
+        SnapshotModel& snapshotModel = snapshotHeader.models[predictionModel.model];
+
+        if (predictionModel.model == Model::Statistics || predictionModel.model == Model::HistoricDictionary)
+        {
+            snapshotModel.used = history.historicData.used;
+            snapshotModel.evictions = history.historicData.evictions;
+            sections.emplace_back(&snapshotModel.table, std::as_bytes(history.historicData.buckets));
+        }
+        else
+        {
+            const std::vector<Performance>& bucketPerformance =
+                predictionModel.model == Model::Distance ? history.match.lengthPerformance : history.dictionary.offsetPerformance;
+            sections.emplace_back(&snapshotModel.bucketPerformance, std::as_bytes(std::span(bucketPerformance)));
+        }
+
+        sections.emplace_back(&snapshotModel.stateMap, std::as_bytes(std::span(history.stateMap)));
+        sections.emplace_back(&snapshotModel.performance, std::as_bytes(std::span(history.performance)));
+    }
+
+    sections.emplace_back(&snapshotHeader.mixerWeights, std::as_bytes(std::span(predictor.mixer.weights)));
+
+    for (std::size_t map = 0; map < mapCount; map++)
+    {
+        sections.emplace_back(&snapshotHeader.probabilityMaps[map], std::as_bytes(std::span(predictor.probabilityMaps[map].cells)));
+    }
+
+    sections.emplace_back(&snapshotHeader.runLengths, std::as_bytes(std::span(predictor.runLengths)));
+
+    std::uint64_t offset = sizeof(SnapshotHeader);
+    std::uint64_t identity = hashBasis;
+
+    for (const auto& [section, bytes]: sections)
+    {
+        offset = (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+        *section = SnapshotSection{offset, bytes.size()};
+        offset += bytes.size();
+        identity = SnapshotHash(bytes, identity);
+    }
+
+    snapshotHeader.identity = std::max<std::uint64_t>(identity, 1);
+
+    std::ofstream snapshotFile(target, std::ios::binary | std::ios::trunc);
+    snapshotFile.write(reinterpret_cast<const char*>(&snapshotHeader), sizeof(SnapshotHeader));
+
+    for (const auto& [section, bytes]: sections)
+    {
+        const std::vector<char> padding(static_cast<std::size_t>(section->offset) - static_cast<std::size_t>(snapshotFile.tellp()));
+
+        snapshotFile.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        snapshotFile.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    if (snapshotFile.fail())
+    {
+        throw std::runtime_error("Could not write to file " + target);
+    }
+
+    return offset;
+}
+
+CodingReport LearnTarget(const Operation& operation, const std::string& outputTarget)
+{
+    CodingReport codingReport;
+    codingReport.inputSize = operation.inputBytes.size();
+
+    if (!operation.command.snapshot.empty() && std::filesystem::exists(outputTarget) &&
+        std::filesystem::equivalent(operation.command.snapshot, outputTarget))
+    {
+        throw std::runtime_error("Could not overwrite " + outputTarget + " while learning from it");
+    }
+
+    const ArchiveHeader archiveHeader = StreamHeader(operation, codingReport);
+    Predictor predictor = CreatePredictor(operation, archiveHeader);
+
+    ByteSink byteSink;
+    byteSink.discard = true;
+    ArithmeticEncoder encoder;
+
+    WithPipeline(archiveHeader.preset, [&operation, &predictor, &encoder, &byteSink, &codingReport](auto pipeline)
+    {
+        EncodeBits<decltype(pipeline)>(operation.inputBytes, predictor, encoder, byteSink, codingReport);
+    });
+
+    codingReport.outputSize = WriteSnapshot(predictor, archiveHeader, outputTarget);
+    codingReport.modelSeconds = ModelSeconds(predictor);
+
+    return codingReport;
+}
+
+bool TakeTask(std::vector<WorkQueue>& workQueues, std::size_t worker, std::size_t& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(workQueues[worker].mutex);
+
+        if (!workQueues[worker].tasks.empty())
+        {
+            task = workQueues[worker].tasks.front();
+            workQueues[worker].tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (std::size_t offset = 1; offset < workQueues.size(); offset++)
+    {
+        WorkQueue& victim = workQueues[(worker + offset) % workQueues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void RunTasks(std::size_t taskCount, std::size_t jobs, const std::function<void(std::size_t)>& runTask)
+{
+    const std::size_t workers = std::max<std::size_t>(1, std::min(jobs, taskCount));
+
+    std::vector<WorkQueue> workQueues(workers);
+    std::vector<std::exception_ptr> failures(workers);
+    std::vector<std::thread> threads;
+
+    for (std::size_t task = 0; task < taskCount; task++)
+    {
+        workQueues[task % workers].tasks.push_back(task);
+    }
+
+    for (std::size_t worker = 0; worker < workers; worker++)
+    {
+        threads.emplace_back([&workQueues, &failures, &runTask, worker]()
+        {
+            try
+            {
+                std::size_t task = 0;
+
+                while (TakeTask(workQueues, worker, task))
+                {
+                    runTask(task);
+                }
+            }
+            catch (...)
+            {
+                failures[worker] = std::current_exception();
+            }
+        });
+    }
+
+    for (std::thread& thread: threads)
+    {
+        thread.join();
+    }
+
+    for (const std::exception_ptr& failure: failures)
+    {
+        if (failure)
+        {
+            std::rethrow_exception(failure);
+        }
+    }
+}
+
+CodingReport MergeReports(const std::vector<CodingReport>& blockReports)
+{
+    CodingReport codingReport;
+
+    for (const CodingReport& blockReport: blockReports)
+    {
+        codingReport.inputSize += blockReport.inputSize;
+        codingReport.correctBits += blockReport.correctBits;
+        codingReport.dictionaryEntries += blockReport.dictionaryEntries;
+        codingReport.dictionarySeconds += blockReport.dictionarySeconds;
+
+        if (codingReport.modelSeconds.empty())
+        {
+            codingReport.modelSeconds = blockReport.modelSeconds;
+            continue;
+        }
+
+        for (std::size_t model = 0; model < blockReport.modelSeconds.size(); model++)
+        {
+            codingReport.modelSeconds[model].second += blockReport.modelSeconds[model].second;
+        }
+    }
+
+    return codingReport;
+}
+
+CodingReport CompressBlocks(const Operation& operation, const std::string& outputTarget)
+{
+    const std::size_t defaultBlockSize = 1 << 24;
+    const std::size_t blockSize = operation.command.blockSize == 0 ? defaultBlockSize : operation.command.blockSize;
+    const std::size_t blockCount = (operation.inputBytes.size() + blockSize - 1) / blockSize;
+
+    std::vector<std::vector<unsigned char>> blockOutputs(blockCount);
+    std::vector<CodingReport> blockReports(blockCount);
+    std::vector<bool> finishedBlocks(blockCount);
+    std::size_t writtenBlocks = 0;
+    std::mutex outputMutex;
+
+    ContainerHeader containerHeader;
+    containerHeader.originalSize = operation.inputBytes.size();
+    containerHeader.blocks.resize(blockCount);
+
+    ByteSink byteSink;
+    OpenSink(byteSink, outputTarget);
+    WriteContainerHeader(byteSink, containerHeader);
+
+    RunTasks(blockCount, operation.command.jobs, [&](std::size_t block)
+    {
+        const std::size_t blockStart = block * blockSize;
+
+        Operation blockOperation;
+        blockOperation.command = operation.command;
+        blockOperation.inputBytes =
+            operation.inputBytes.subspan(blockStart, std::min(blockSize, operation.inputBytes.size() - blockStart));
+
+        std::vector<unsigned char> blockOutput;
+        ByteSink blockSink;
+        blockSink.memory = &blockOutput;
+        const CodingReport blockReport = CompressStream(blockOperation, blockSink);
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        blockOutputs[block] = std::move(blockOutput);
+        blockReports[block] = blockReport;
+        finishedBlocks[block] = true;
+
+        for (; writtenBlocks < blockCount && finishedBlocks[writtenBlocks]; writtenBlocks++)
+        {
+            PutBytes(byteSink, blockOutputs[writtenBlocks]);
+            containerHeader.blocks[writtenBlocks] =
+                BlockEntry{blockReports[writtenBlocks].inputSize, blockOutputs[writtenBlocks].size()};
+            blockOutputs[writtenBlocks] = std::vector<unsigned char>();
+        }
+    });
+
+    FlushSink(byteSink);
+
+    CodingReport codingReport = MergeReports(blockReports);
+    codingReport.outputSize = byteSink.written;
+
+    byteSink.outputFile.seekp(0);
+    WriteContainerHeader(byteSink, containerHeader);
+    FlushSink(byteSink);
+
+    return codingReport;
+}
+
+CodingReport DecompressBlocks(const Operation& operation, const std::string& outputTarget)
+{
+    ByteSource byteSource;
+    OpenSource(byteSource, operation.command.target);
+    const ContainerHeader containerHeader = ReadContainerHeader(byteSource, operation.command.target);
+    const std::size_t blockCount = containerHeader.blocks.size();
+
+    std::vector<std::uint64_t> archiveOffsets(blockCount);
+    std::vector<std::uint64_t> outputOffsets(blockCount);
+    std::uint64_t archiveOffset = ContainerHeaderSize(containerHeader);
+    std::uint64_t outputOffset = 0;
+
+    for (std::size_t block = 0; block < blockCount; block++)
+    {
+        archiveOffsets[block] = archiveOffset;
+        outputOffsets[block] = outputOffset;
+        archiveOffset += containerHeader.blocks[block].compressedSize;
+        outputOffset += containerHeader.blocks[block].originalSize;
+    }
+
+    if (archiveOffset != std::filesystem::file_size(operation.command.target))
+    {
+        throw std::runtime_error(operation.command.target + " is truncated or corrupt");
+    }
+
+    const std::uint64_t rangeStart = std::min(operation.command.range.start, containerHeader.originalSize);
+    const std::uint64_t rangeEnd = rangeStart + std::min(operation.command.range.length, containerHeader.originalSize - rangeStart);
+    const std::size_t firstBlock = static_cast<std::size_t>(
+        std::upper_bound(outputOffsets.begin(), outputOffsets.end(), rangeStart) - outputOffsets.begin()) - (blockCount == 0 ? 0 : 1);
+    const std::size_t lastBlock = static_cast<std::size_t>(
+        std::lower_bound(outputOffsets.begin(), outputOffsets.end(), rangeEnd) - outputOffsets.begin());
+
+    ByteSink byteSink;
+    OpenSink(byteSink, outputTarget);
+    byteSink.outputFile.close();
+    std::filesystem::resize_file(outputTarget, rangeEnd - rangeStart);
+
+    std::vector<CodingReport> blockReports(lastBlock - firstBlock);
+
+    RunTasks(blockReports.size(), operation.command.jobs, [&](std::size_t task)
+    {
+        const std::size_t block = firstBlock + task;
+        const BlockEntry& blockEntry = containerHeader.blocks[block];
+        const std::uint64_t blockStart = std::max(rangeStart, outputOffsets[block]);
+        const std::uint64_t blockEnd = std::min(rangeEnd, outputOffsets[block] + blockEntry.originalSize);
+
+        ByteRange blockRange;
+        blockRange.start = blockStart - outputOffsets[block];
+        blockRange.length = blockEnd - blockStart;
+
+        ByteSource blockSource;
+        OpenSource(blockSource, operation.command.target);
+        blockSource.inputFile.seekg(static_cast<std::streamoff>(archiveOffsets[block]));
+        blockSource.remaining = blockEntry.compressedSize;
+
+        ByteSink blockSink;
+        OpenSinkAt(blockSink, outputTarget, blockStart - rangeStart);
+
+        blockReports[task] = DecompressStream(operation, blockSource, blockSink, blockRange);
+
+        if (blockReports[task].inputSize != blockEntry.originalSize)
+        {
+            throw std::runtime_error(operation.command.target + " has a corrupt block " + std::to_string(block));
+        }
+    });
+
+    CodingReport codingReport = MergeReports(blockReports);
+    codingReport.outputSize = rangeEnd - rangeStart;
+
+    return codingReport;
+}
+
+CodingReport CompressTarget(const Operation& operation, const std::string& outputTarget)
+{
+    if (operation.command.jobs > 1 || operation.command.blockSize != 0)
+    {
+        return CompressBlocks(operation, outputTarget);
+    }
+
+    ByteSink byteSink;
+    OpenSink(byteSink, outputTarget);
+
+    return CompressStream(operation, byteSink);
+}
+
+CodingReport DecompressTarget(const Operation& operation, const std::string& outputTarget)
+{
+    if (ArchiveVersion(operation.command.target) == ContainerHeader().version)
+    {
+        return DecompressBlocks(operation, outputTarget);
+    }
+
+    ByteSource byteSource;
+    OpenSource(byteSource, operation.command.target);
+
+    ByteSink byteSink;
+    OpenSink(byteSink, outputTarget);
+
+    return DecompressStream(operation, byteSource, byteSink, operation.command.range);
+}
+
+std::string DecompressedTarget(const std::string& target)
+{
+    const std::string archiveExtension = ".iw";
+
+    if (target.size() > archiveExtension.size() && target.ends_with(archiveExtension))
+    {
+        return target.substr(0, target.size() - archiveExtension.size());
+    }
+
+    return target + ".out";
+}
+
+void CheckOutputTarget(const Command& command, const std::string& outputTarget)
+{
+    if (!command.force && std::filesystem::exists(outputTarget))
+    {
+        throw std::runtime_error(outputTarget + " already exists, pass -f to overwrite it");
+    }
+}
+
+void ProcessTarget(const Operation& operation)
+{
+    const std::size_t numberBits = 8;
+
+    if (operation.command.action == Action::Decompress)
+    {
+        const std::string outputTarget =
+            DecompressedTarget(operation.command.target) + (operation.command.range == ByteRange() ? "" : ".part");
+        CheckOutputTarget(operation.command, outputTarget);
+        CodingReport codingReport;
+
+        try
+        {
+            codingReport = DecompressTarget(operation, outputTarget);
+        }
+        catch (...)
+        {
+            std::filesystem::remove(outputTarget);
+            throw;
+        }
+
+        std::cout << operation.command.target << ": " << codingReport.outputSize << " bytes written to "
+                  << outputTarget << std::endl;
+
+        return;
+    }
+
+    if (operation.command.action == Action::Learn)
+    {
+        const std::string outputTarget = operation.command.target + ".iws";
+        CheckOutputTarget(operation.command, outputTarget);
+        const CodingReport codingReport = LearnTarget(operation, outputTarget);
+
+        std::cout << operation.command.target << ": " << codingReport.inputSize << " bytes learned, " << codingReport.outputSize
+                  << " byte snapshot written to " << outputTarget << std::endl;
+
+        return;
+    }
+
+    const std::string outputTarget = operation.command.target + ".iw";
+    CheckOutputTarget(operation.command, outputTarget);
+    const CodingReport codingReport = CompressTarget(operation, outputTarget);
+    const double inputSize = static_cast<double>(codingReport.inputSize == 0 ? 1 : codingReport.inputSize);
+
+    std::cout << operation.command.target << ": " << codingReport.inputSize << " -> " << codingReport.outputSize
+              << " bytes (" << static_cast<double>(codingReport.outputSize * numberBits) / inputSize << " bits per byte, "
+              << static_cast<double>(codingReport.correctBits) / (inputSize * numberBits) * 100.0
+              << "% bits guessed, " << codingReport.dictionaryEntries << " dictionary entries built in "
+              << codingReport.dictionarySeconds << " s) written to " << outputTarget << std::endl;
+
+    return;
+}
+
+void ValidateArguments(const std::vector<std::string>& cliArguments) {
+    const std::size_t expectedArguments = 3;
+    const std::size_t optionArguments = 2;
+    const std::vector<std::string> optionNames{"-j", "--jobs", "-b", "--block-size", "-m", "--mem", "-p", "--preset", "-t", "--threads", "-s", "--snapshot", "-r", "--range"};
+
+    if (cliArguments.size() < expectedArguments) {
+        throw std::runtime_error("Invalid number of command line arguments\n\n" + GetUsage());
+    }
+
+    for (std::size_t index = expectedArguments; index < cliArguments.size(); index += IsFlag(cliArguments[index]) ? 1 : optionArguments) {
+        if (IsFlag(cliArguments[index])) {
+            continue;
+        }
+
+        if (std::find(optionNames.begin(), optionNames.end(), cliArguments[index]) == optionNames.end()) {
+            throw std::runtime_error(cliArguments[index] + " is not a valid option\n\n" + GetUsage());
+        }
+
+        if (index + 1 == cliArguments.size()) {
+            throw std::runtime_error("Invalid number of command line arguments\n\n" + GetUsage());
+        }
+    }
+}
+
+Command GetCommand(const std::vector<std::string>& cliArguments)
+{
+    Command command;
+
+    command.action = GetAction(cliArguments);
+    command.target = GetTarget(cliArguments);
+    command.jobs = GetJobs(cliArguments);
+    command.blockSize = GetBlockSize(cliArguments);
+    command.memory = GetMemory(cliArguments);
+    command.explicitMemory = !GetOption(cliArguments, "-m", "--mem").empty();
+    command.preset = GetPreset(cliArguments);
+    command.explicitPreset = !GetOption(cliArguments, "-p", "--preset").empty();
+    command.modelThreads = GetModelThreads(cliArguments);
+    command.snapshot = GetSnapshot(cliArguments);
+    command.range = GetRange(cliArguments);
+    command.force = HasFlag(cliArguments, "-f", "--force");
+
+    return command;
+}
+
+void ExecuteCommand(const Command& command)
+{
+    Operation operation;
+    InputBuffer inputBuffer;
+
+    operation.command = command;
+
+    if (command.action != Action::Decompress)
+    {
+        OpenInput(inputBuffer, command.target);
+        operation.inputBytes = InputBytes(inputBuffer);
+    }
+
+    ProcessTarget(operation);
+
+    return;
+}
+
+#ifdef COMPRESSOR_TEST
+std::size_t allocationCount = 0;
+
+[[gnu::noinline]] void* CountedAllocation(std::size_t size, std::size_t alignment)
+{
+    allocationCount++;
+
+    const std::size_t alignedSize = (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment;
+
+    if (void* memory = alignment <= alignof(std::max_align_t) ? std::malloc(alignedSize) : std::aligned_alloc(alignment, alignedSize))
+    {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void ReleaseAllocation(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void* operator new(std::size_t size)
+{
+    return CountedAllocation(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size)
+{
+    return CountedAllocation(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return CountedAllocation(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return CountedAllocation(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept
+{
+    ReleaseAllocation(memory);
+}
+
+std::vector<Vote> CollectVotes(
+    void (*modelVotes)(const Predictor&, const std::vector<unsigned char>&, std::vector<Vote>&),
+    const Predictor& predictor,
+    const std::vector<unsigned char>& guessedBits)
+{
+    std::vector<Vote> votes;
+    modelVotes(predictor, guessedBits, votes);
+
+    return votes;
+}
+
+void TestBitInput()
+{
+    assert(GetBitFromInput(std::vector<unsigned char>{0}, 0) == 0);
+    assert(GetBitFromInput(std::vector<unsigned char>{1}, 0) == 0);
+    assert(GetBitFromInput(std::vector<unsigned char>{128}, 0) == 1);
+    assert(GetBitFromInput(std::vector<unsigned char>{128, 0}, 0) == 1);
+    assert(GetBitFromInput(std::vector<unsigned char>{128, 0}, 1) == 0);
+    assert(GetBitFromInput(std::vector<unsigned char>{128, 0}, 9) == 0);
+    assert(GetBitFromInput(std::vector<unsigned char>{255, 0}, 7) == 1);
+    assert(GetBitFromInput(std::vector<unsigned char>{128, 255}, 9) == 1);
+    assert(GetBitFromInput(std::vector<unsigned char>{128, 64, 2, 0}, 23) == 0);
+    assert(GetBitFromInput(std::vector<unsigned char>{128, 64, 2, 0}, 22) == 1);
+}
+
+void TestContextKeys()
+{
+    assert(GenerateKey(CombinationData(1, 0)) == PackContext(1, 0));
+    assert(GenerateKey(CombinationData(1, 1)) == PackContext(1, 1));
+    assert(GenerateKey(CombinationData(2, 0)) != GenerateKey(CombinationData(1, 0)));
+    assert(GenerateKey(CombinationData(2, 2)) == PackContext(2, 2));
+    assert(GenerateKey(CombinationData(2, 6)) == PackContext(2, 2));
+    assert(GenerateKey(CombinationData(4, 5)) != GenerateKey(CombinationData(8, 5)));
+    assert(GenerateKey(CombinationData(16, 127)) == PackContext(16, 127));
+    assert(GenerateEntryKey(CombinationData(1, 1), 0) != GenerateEntryKey(CombinationData(1, 0), 1));
+    assert(GenerateEntryKey(CombinationData(2, 1), 2) == GenerateKey(CombinationData(4, 6)));
+
+    ContextTable testTable;
+    InitializeContextTable(testTable, 1000);
+    assert(testTable.buckets.size() == 512 / bucketSlots);
+    assert(reinterpret_cast<std::uintptr_t>(testTable.buckets.data()) % 64 == 0);
+    assert(sizeof(ContextBucket) == 64);
+    assert(FindContext(testTable, PackContext(1, 0)) == nullptr);
+    ContextState(testTable, PackContext(1, 0)).states[0] = 3;
+    assert(FindContext(testTable, PackContext(1, 0))->states[0] == 3);
+    assert(FindContext(testTable, PackContext(1, 1)) == nullptr);
+
+    for (std::uint64_t pattern = 0; pattern < 100; pattern++)
+    {
+        ContextState(testTable, PackContext(8, pattern)).states[nibbleNodes - 1] = stateTable[0].next[1];
+    }
+
+    assert(testTable.used == 101);
+    assert(testTable.evictions == 0);
+    assert(FindContext(testTable, PackContext(1, 0))->states[0] == 3);
+    assert(FindContext(testTable, PackContext(8, 99))->states[nibbleNodes - 1] == stateTable[0].next[1]);
+
+    ContextTable boundedTable;
+    InitializeContextTable(boundedTable, bucketSlots);
+    ContextState(boundedTable, PackContext(1, 0)).states[0] = stateTable[stateTable[0].next[0]].next[0];
+
+    for (std::uint64_t pattern = 0; pattern < 12; pattern++)
+    {
+        ContextState(boundedTable, PackContext(8, pattern)).states[0] = stateTable[0].next[1];
+    }
+
+    assert(boundedTable.buckets.size() == 1);
+    assert(boundedTable.used == bucketSlots);
+    assert(boundedTable.evictions == 12 - (bucketSlots - 1));
+    assert(FindContext(boundedTable, PackContext(1, 0))->states[0] == stateTable[stateTable[0].next[0]].next[0]);
+    assert(FindContext(boundedTable, PackContext(8, 11))->states[0] == stateTable[0].next[1]);
+
+    assert(BitPosition(RelativePosition(0, 1)) == 0);
+    assert(BitPosition(RelativePosition(1, 1)) == 0);
+    assert(BitPosition(RelativePosition(1, 2)) == 1);
+    assert(BitPosition(RelativePosition(2, 1)) == 0);
+    assert(BitPosition(RelativePosition(2, 2)) == 0);
+    assert(BitPosition(RelativePosition(3, 1)) == 0);
+    assert(BitPosition(RelativePosition(3, 2)) == 1);
+    assert(BitPosition(RelativePosition(4, 4)) == 0);
+    assert(BitPosition(RelativePosition(30, 4)) == 2);
+    assert(BitPosition(RelativePosition(5, 4)) == 1);
+    assert(BitPosition(RelativePosition(7, 4)) == 3);
+
+    assert(GeneratePartialKey(2, CombinationData(0, 0)) == PackContext(2, 1));
+    assert(GeneratePartialKey(2, CombinationData(1, 1)) == PackContext(2, 3));
+    assert(GeneratePartialKey(2, CombinationData(2, 1)) == PackContext(2, 5));
+    assert(GeneratePartialKey(2, CombinationData(1, 0)) != GeneratePartialKey(2, CombinationData(2, 0)));
+}
+
+void TestHistoricKeys()
+{
+    Predictor testPredictor;
+    std::vector<unsigned char> testInput;
+    testPredictor.operationStatus.position.inputPosition = 1;
+    testPredictor.operationStatus.position.virtualPosition = 1;
+    testInput = {0};
+    testPredictor.operationStatus.operation.inputBytes = testInput;
+    RebuildBitHistory(testPredictor);
+    assert(GenerateHistoricKey(testPredictor, {}, 1) == 0);
+
+    testInput = {128};
+    testPredictor.operationStatus.operation.inputBytes = testInput;
+    RebuildBitHistory(testPredictor);
+    assert(GenerateHistoricKey(testPredictor, {}, 1) == 1);
+
+    testInput = {64};
+    testPredictor.operationStatus.operation.inputBytes = testInput;
+    RebuildBitHistory(testPredictor);
+    assert(GenerateHistoricKey(testPredictor, {}, 1) == 0);
+
+    testInput = {64};
+    testPredictor.operationStatus.operation.inputBytes = testInput;
+    testPredictor.operationStatus.position.virtualPosition = 2;
+    assert(GenerateHistoricKey(testPredictor, {1}, 1) == 1);
+
+    assert(GenerateHistoricKey(testPredictor, {1}, 2) == 1);
+
+    testInput = {128};
+    testPredictor.operationStatus.operation.inputBytes = testInput;
+    testPredictor.operationStatus.position.inputPosition = 2;
+    testPredictor.operationStatus.position.virtualPosition = 4;
+    RebuildBitHistory(testPredictor);
+    assert(WalkHistoricKey(testPredictor.operationStatus.operation.inputBytes, 2, 2) == 2);
+    assert(GenerateHistoricKey(testPredictor, {1, 0}, 4) == 10);
+}
+
+void TestBitStates()
+{
+    std::uint8_t state = 0;
+    assert(stateTable[state].zeros == 0 && stateTable[state].ones == 0);
+    assert(StateProbability(state) == probabilityScale / 2);
+
+    for (std::size_t repeat = 0; repeat < 100; repeat++)
+    {
+        state = stateTable[state].next[1];
+    }
+
+    assert(stateTable[state].zeros == 0 && stateTable[state].ones == stateCountLimit);
+    assert(StateProbability(state) > probabilityScale - probabilityScale / 32);
+
+    state = stateTable[state].next[0];
+    assert(stateTable[state].zeros == 1 && stateTable[state].ones == stateCountLimit / 2 + 1);
+
+    for (const BitState& bitState: stateTable)
+    {
+        assert(bitState.zeros <= stateCountLimit && bitState.ones <= stateCountLimit);
+    }
+
+    Performance performance;
+    Adapt(performance.accuracy, performance.count, 1, performanceAdaptLimit);
+    assert(performance.accuracy == probabilityScale - 1);
+    Adapt(performance.accuracy, performance.count, 0, performanceAdaptLimit);
+    assert(performance.accuracy == probabilityScale / 2 - 1);
+    assert(performance.count == 2);
+}
+
+void TestModelVotes()
+{
+    const std::uint16_t halfScale = probabilityScale / 2;
+
+    Predictor testPredictor;
+    testPredictor.predictionModels[Model::Statistics] = PredictionModel(Model::Statistics);
+    testPredictor.predictionModels[Model::HistoricDictionary] = PredictionModel(Model::HistoricDictionary);
+    PredictionModel& statisticsModel = testPredictor.predictionModels[Model::Statistics];
+    ContextTable& statisticsHistory = statisticsModel.history.historicData;
+
+    std::vector<unsigned char> testGuessedBits;
+
+    assert(CollectVotes(StatisticsVotes, testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(0, 0, halfScale)}));
+    assert(CollectVotes(HistoricVotes, testPredictor, testGuessedBits) == (std::vector<Vote>{}));
+
+    const std::uint8_t oneState = stateTable[0].next[1];
+    ContextState(statisticsHistory, GeneratePartialKey(1, CombinationData(0, 0))).states[0] = oneState;
+    assert(CollectVotes(StatisticsVotes, testPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, StateProbability(oneState), halfScale)}));
+
+    const std::uint8_t zeroState = stateTable[stateTable[0].next[0]].next[0];
+    const Vote zeroVote(0, probabilityScale - StateProbability(zeroState), 3000);
+    ContextState(statisticsHistory, GeneratePartialKey(1, CombinationData(0, 0))).states[0] = zeroState;
+    statisticsModel.history.performance[0] = Performance{3000, 5};
+    assert(CollectVotes(StatisticsVotes, testPredictor, testGuessedBits) == (std::vector<Vote>{zeroVote}));
+
+    statisticsModel.levels = 2;
+    assert(CollectVotes(StatisticsVotes, testPredictor, testGuessedBits) == (std::vector<Vote>{zeroVote, Vote(0, 0, halfScale)}));
+
+    testPredictor.operationStatus.position.virtualPosition = 1;
+    testGuessedBits = { 1 };
+    ContextState(statisticsHistory, GeneratePartialKey(2, CombinationData(0, 0))).states[NibbleNode(2, 1, 1)] = oneState;
+    assert(NibbleNode(2, 1, 1) == 2);
+    assert(CollectVotes(StatisticsVotes, testPredictor, testGuessedBits) == (std::vector<Vote>{zeroVote, Vote(1, StateProbability(oneState), halfScale)}));
+
+    testGuessedBits = { 0 };
+    assert(CollectVotes(StatisticsVotes, testPredictor, testGuessedBits) == (std::vector<Vote>{zeroVote, Vote(0, 0, halfScale)}));
+
+    assert(NibbleNode(1, 3, 7) == 0);
+    assert(NibbleNode(8, 0, 5) == 0);
+    assert(NibbleNode(8, 3, 5) == 12);
+    assert(NibbleNode(16, 2, 2) == 5);
+
+    Predictor recordPredictor;
+    recordPredictor.predictionModels[Model::Statistics] = PredictionModel(Model::Statistics);
+    recordPredictor.predictionModels[Model::Statistics].levels = 2;
+    const std::vector<unsigned char> recordInput{176};
+    recordPredictor.operationStatus.operation.inputBytes = recordInput;
+
+    for (std::size_t bitPosition = 0; bitPosition < 4; bitPosition++)
+    {
+        unsigned char bit = GetBitFromInput(recordPredictor.operationStatus.operation.inputBytes, bitPosition);
+        RecordStatistics(recordPredictor, bit);
+        AdvancePosition(recordPredictor, bit);
+    }
+
+    const std::uint8_t levelOneState = stateTable[stateTable[stateTable[oneState].next[0]].next[1]].next[1];
+    const std::uint8_t levelTwoState = stateTable[oneState].next[1];
+
+    assert(recordPredictor.bitHistory.recentBits == 11);
+    assert(recordPredictor.predictionModels.at(Model::Statistics).history.activeNibble == 0);
+    testGuessedBits = {};
+    assert(CollectVotes(StatisticsVotes, recordPredictor, testGuessedBits) == (std::vector<Vote>{Vote(1, StateProbability(levelOneState), halfScale), Vote(1, StateProbability(levelTwoState), halfScale)}));
+
+    Predictor historicPredictor;
+    historicPredictor.predictionModels[Model::HistoricDictionary] = PredictionModel(Model::HistoricDictionary);
+    const std::vector<unsigned char> historicInput{170};
+    historicPredictor.operationStatus.operation.inputBytes = historicInput;
+
+    for (std::size_t bitPosition = 0; bitPosition < 8; bitPosition++)
+    {
+        unsigned char bit = GetBitFromInput(historicPredictor.operationStatus.operation.inputBytes, bitPosition);
+        RecordHistoric(historicPredictor, bit);
+        AdvancePosition(historicPredictor, bit);
+    }
+
+    SelectPredictorSlots(historicPredictor);
+    assert(historicPredictor.predictionModels.at(Model::HistoricDictionary).history.activeNibble == 8);
+    assert(historicPredictor.predictionModels.at(Model::HistoricDictionary).history.historicData.used == 1);
+    assert(CollectVotes(HistoricVotes, historicPredictor, {}) == (std::vector<Vote>{Vote(1, StateProbability(oneState), halfScale)}));
+
+    const std::uint8_t singleZeroState = stateTable[0].next[0];
+    historicPredictor.operationStatus.position.virtualPosition++;
+    assert(CollectVotes(HistoricVotes, historicPredictor, {1}) == (std::vector<Vote>{Vote(0, probabilityScale - StateProbability(singleZeroState), halfScale)}));
+}
+
+void TestCommands()
+{
+    assert(GetAction({"Compressor", "-c", "enwik3"}) == Action::Compress);
+    assert(GetAction({"Compressor", "-d", "enwik3"}) == Action::Decompress);
+    assert(GetAction({"Compressor", "--compress", "enwik3"}) == Action::Compress);
+    assert(GetAction({"Compressor", "--decompress", "enwik3"}) == Action::Decompress);
+    assert(GetAction({"Compressor", "-l", "enwik3"}) == Action::Learn);
+    assert(GetAction({"Compressor", "--learn", "enwik3"}) == Action::Learn);
+
+    assert(GetTarget({"Compressor", "-c", "enwik3"}) == "enwik3");
+    assert(GetTarget({"Compressor", "-c", "enwik5"}) == "enwik5");
+    assert(GetTarget({"Compressor", "-c", "enwik7"}) == "enwik7");
+    assert(GetTarget({"Compressor", "-c", "enwik9"}) == "enwik9");
+
+    assert(GetCommand({"Compressor", "-c", "enwik3"}) == Command(Action::Compress, "enwik3"));
+    assert(GetCommand({"Compressor", "-d", "enwik5"}) == Command(Action::Decompress, "enwik5"));
+    assert(GetCommand({"Compressor", "--compress", "enwik7"}) == Command(Action::Compress, "enwik7"));
+    assert(GetCommand({"Compressor", "--decompress", "enwik9"}) == Command(Action::Decompress, "enwik9"));
+    assert(GetJobs({"Compressor", "-c", "enwik9"}) == 1);
+    assert(GetJobs({"Compressor", "-c", "enwik9", "-j", "8"}) == 8);
+    assert(GetJobs({"Compressor", "-c", "enwik9", "--jobs", "3"}) == 3);
+    assert(GetJobs({"Compressor", "-c", "enwik9", "-b", "4096", "-j", "2"}) == 2);
+    assert(GetBlockSize({"Compressor", "-c", "enwik9"}) == 0);
+    assert(GetBlockSize({"Compressor", "-c", "enwik9", "--block-size", "4096"}) == 4096);
+    assert(GetMemory({"Compressor", "-c", "enwik9"}) == Command().memory);
+    assert(GetMemory({"Compressor", "-c", "enwik9", "--mem", "512M"}) == static_cast<std::uint64_t>(1) << 29);
+    assert(GetMemory({"Compressor", "-c", "enwik9", "-m", "3G"}) == static_cast<std::uint64_t>(1) << 31);
+    assert(GetMemory({"Compressor", "-c", "enwik9", "-m", "1048576"}) == static_cast<std::uint64_t>(1) << 20);
+    assert(GetPreset({"Compressor", "-c", "enwik9"}) == defaultPreset);
+    assert(GetPreset({"Compressor", "-c", "enwik9", "-p", "1"}) == 1);
+    assert(GetPreset({"Compressor", "-c", "enwik9", "--preset", "9"}) == 9);
+    assert(GetModelThreads({"Compressor", "-c", "enwik9"}) == 1);
+    assert(GetModelThreads({"Compressor", "-c", "enwik9", "-t", "3"}) == 3);
+    assert(GetModelThreads({"Compressor", "-c", "enwik9", "--threads", "4"}) == 4);
+    assert(GetSnapshot({"Compressor", "-c", "enwik9"}).empty());
+    assert(GetSnapshot({"Compressor", "-c", "enwik2", "-s", "enwik9.iws"}) == "enwik9.iws");
+    assert(GetRange({"Compressor", "-d", "enwik9.iw"}) == ByteRange());
+    assert(GetRange({"Compressor", "-d", "enwik9.iw", "-r", "100:20"}) == (ByteRange{100, 20}));
+    assert(!HasFlag({"Compressor", "-d", "enwik9.iw"}, "-f", "--force"));
+    assert(HasFlag({"Compressor", "-d", "enwik9.iw", "-f"}, "-f", "--force"));
+    assert(HasFlag({"Compressor", "-d", "enwik9.iw", "-r", "100:20", "--force"}, "-f", "--force"));
+    assert(GetRange({"Compressor", "-d", "enwik9.iw", "-f", "-r", "100:20"}) == (ByteRange{100, 20}));
+    assert(GetCommand({"Compressor", "-d", "enwik9.iw", "-f"}).force);
+    assert(!GetCommand({"Compressor", "-c", "enwik9"}).explicitPreset);
+    assert(GetCommand({"Compressor", "-c", "enwik9", "-p", "6"}).explicitPreset);
+    assert(GetCommand({"Compressor", "-c", "enwik9", "--mem", "256M"}).explicitMemory);
+
+    bool rejected = false;
+
+    try
+    {
+        ValidateArguments({"Compressor", "-d", "enwik9.iw", "-r"});
+    }
+    catch (const std::runtime_error&)
+    {
+        rejected = true;
+    }
+
+    assert(rejected);
+    rejected = false;
+
+    try
+    {
+        CheckOutputTarget(Command(Action::Decompress, "enwik3.iw"), "enwik3");
+    }
+    catch (const std::runtime_error&)
+    {
+        rejected = true;
+    }
+
+    assert(rejected);
+
+    for (const std::vector<std::string>& threadsArguments: std::vector<std::vector<std::string>>{
+             {"Compressor", "-c", "enwik9", "-t", "5"},
+             {"Compressor", "-d", "enwik9.iw", "-t", "2"},
+             {"Compressor", "-l", "enwik9", "--threads", "2"}})
+    {
+        rejected = false;
+
+        try
+        {
+            GetModelThreads(threadsArguments);
+        }
+        catch (const std::runtime_error&)
+        {
+            rejected = true;
+        }
+
+        assert(rejected);
+    }
+
+    for (const std::vector<std::string>& rangeArguments: std::vector<std::vector<std::string>>{
+             {"Compressor", "-c", "enwik9", "-r", "100:20"},
+             {"Compressor", "-l", "enwik9", "--range", "100:20"}})
+    {
+        rejected = false;
+
+        try
+        {
+            GetRange(rangeArguments);
+        }
+        catch (const std::runtime_error&)
+        {
+            rejected = true;
+        }
+
+        assert(rejected);
+    }
+
+    ValidateArguments({"Compressor", "-d", "enwik9.iw", "-f", "-r", "100:20"});
+    CheckOutputTarget(GetCommand({"Compressor", "-d", "enwik3.iw", "--force"}), "enwik3");
+}
+
+void TestFixtures()
+{
+    assert(ReadTarget("enwik") == (std::vector<unsigned char>{}));
+    assert(ReadTarget("enwik1") == (std::vector<unsigned char>{'<', 'm', 'e', 'd', 'i', 'a', 'w', 'i', 'k', 'i'}));
+    assert(ReadTarget("enwik2").size() == 100);
+    assert(ReadTarget("enwik3").size() == 1000);
+}
+
+void TestMatchModel()
+{
+    const std::vector<unsigned char> matchInput{'<', 'p', 'a', 'g', 'e', '>', '<', 'p', 'a', 'g', 'e', '>'};
+    Operation matchOperation;
+    matchOperation.inputBytes = matchInput;
+    Predictor matchPredictor = CreatePredictor(matchOperation, ArchiveHeader());
+
+    for (std::size_t bitPosition = 0; bitPosition < 7 * 8; bitPosition++)
+    {
+        std::vector<unsigned char> guessedBits;
+        Guess guess;
+        GuessBit(matchPredictor, guessedBits, guess);
+        UpdatePredictor(matchPredictor, guess, GetBitFromInput(matchOperation.inputBytes, bitPosition));
+    }
+
+    assert(matchPredictor.byteHistory.length == 7);
+    assert(WindowByte(matchPredictor.byteHistory, 6) == '<');
+    assert(matchPredictor.predictionModels.at(Model::Distance).history.match.matchLength == 0);
+
+    for (std::size_t bitPosition = 7 * 8; bitPosition < 12 * 8; bitPosition++)
+    {
+        std::vector<unsigned char> guessedBits;
+        Guess guess;
+        GuessBit(matchPredictor, guessedBits, guess);
+        UpdatePredictor(matchPredictor, guess, GetBitFromInput(matchOperation.inputBytes, bitPosition));
+    }
+
+    assert(matchPredictor.predictionModels.at(Model::Distance).history.match.matchLength == 6);
+    assert(matchPredictor.predictionModels.at(Model::Distance).history.match.matchPointer == 6);
+    assert(CollectVotes(DistanceVotes, matchPredictor, {}).front().bit == 0);
+    assert(CollectVotes(DistanceVotes, matchPredictor, {}).front().voteWeight.confidence > 0);
+
+    matchPredictor.operationStatus.position.virtualPosition++;
+    assert(CollectVotes(DistanceVotes, matchPredictor, {1}).front().voteWeight.confidence == 0);
+    assert(CollectVotes(DistanceVotes, matchPredictor, {0}).front().voteWeight.confidence > 0);
+    assert(CollectVotes(DistanceVotes, matchPredictor, {0}).front().bit == 0);
+}
+
+void TestFutureDictionary()
+{
+    const std::string dictionaryText = "<revision><timestamp>2006-03-01T";
+    std::vector<unsigned char> dictionaryInput;
+
+    for (std::size_t repeat = 0; repeat < 1024; repeat++)
+    {
+        dictionaryInput.insert(dictionaryInput.end(), dictionaryText.begin(), dictionaryText.end());
+        dictionaryInput.push_back(static_cast<unsigned char>('0' + repeat % 10));
+        dictionaryInput.push_back('\n');
+    }
+
+    ArchiveHeader dictionaryHeader;
+    dictionaryHeader.dictionary = BuildDictionary(dictionaryInput, Command().memory, 1);
+    assert(BuildDictionary(std::vector<unsigned char>{'<', 'p', 'a', 'g', 'e', '>', '<', 'p', 'a', 'g', 'e', '>'}, Command().memory, 1).empty());
+    assert(BuildDictionary(dictionaryInput, static_cast<std::uint64_t>(1) << minimumMemoryBits, 1) == dictionaryHeader.dictionary);
+
+    CandidateCounts wholeCounts(1 << 10);
+    CandidateCounts chunkCounts(1 << 10);
+    CountCandidates(dictionaryInput, 0, dictionaryInput.size(), wholeCounts);
+    CountCandidates(dictionaryInput, dictionaryInput.size() / 2, dictionaryInput.size(), chunkCounts);
+    CountCandidates(dictionaryInput, 0, dictionaryInput.size() / 2, chunkCounts);
+    assert(CandidateCount(chunkCounts, CandidateHash(dictionaryInput, 0)) == CandidateCount(wholeCounts, CandidateHash(dictionaryInput, 0)));
+    assert(CandidateCount(wholeCounts, CandidateHash(dictionaryInput, 0)) >= 1024 / 10);
+
+    for (std::size_t slot = 0; slot < wholeCounts.counts.size(); slot++)
+    {
+        assert(chunkCounts.counts[slot].load() == wholeCounts.counts[slot].load());
+        assert(chunkCounts.firstPositions[slot].load() == wholeCounts.firstPositions[slot].load());
+    }
+    assert(dictionaryHeader.dictionary.size() == 4);
+    assert(dictionaryHeader.dictionary.front().size() == 32);
+
+    Operation dictionaryOperation;
+    dictionaryOperation.inputBytes = dictionaryInput;
+    Predictor dictionaryPredictor = CreatePredictor(dictionaryOperation, dictionaryHeader);
+
+    for (std::size_t bitPosition = 0; bitPosition < 4 * 8; bitPosition++)
+    {
+        std::vector<unsigned char> guessedBits;
+        Guess guess;
+        GuessBit(dictionaryPredictor, guessedBits, guess);
+        UpdatePredictor(dictionaryPredictor, guess, GetBitFromInput(dictionaryInput, bitPosition));
+    }
+
+    assert(dictionaryPredictor.predictionModels.at(Model::FutureDictionary).history.dictionary.entryOffset == 4);
+    assert(GuessBits(dictionaryPredictor, 8).length == 0);
+    assert(CollectVotes(FutureVotes, dictionaryPredictor, {}).front().bit == ('s' >> 7));
+    assert(CollectVotes(FutureVotes, dictionaryPredictor, {}).front().voteWeight.confidence > 0);
+
+    for (std::size_t bitPosition = 4 * 8; bitPosition < 16 * 8; bitPosition++)
+    {
+        std::vector<unsigned char> guessedBits;
+        Guess guess;
+        GuessBit(dictionaryPredictor, guessedBits, guess);
+        UpdatePredictor(dictionaryPredictor, guess, GetBitFromInput(dictionaryInput, bitPosition));
+    }
+
+    assert(dictionaryPredictor.predictionModels.at(Model::FutureDictionary).history.dictionary.entryOffset == 16);
+    assert(GuessBits(dictionaryPredictor, 8).length == 64);
+    assert(GuessBits(dictionaryPredictor, 8).bits == InputWord(dictionaryInput, 16, 64));
+    assert(GuessBits<LeanPipeline>(dictionaryPredictor, 8).length == 0);
+}
+
+void TestSteadyStateAllocations()
+{
+    const std::string pageText = "<page><title>Steady</title><text>state</text></page>\n";
+    const std::size_t numberBits = 8;
+    std::vector<unsigned char> steadyInput;
+
+    for (std::size_t repeat = 0; repeat < 256; repeat++)
+    {
+        steadyInput.insert(steadyInput.end(), pageText.begin(), pageText.end());
+    }
+
+    Operation steadyOperation;
+    steadyOperation.inputBytes = steadyInput;
+
+    ArchiveHeader steadyHeader;
+    steadyHeader.originalSize = steadyInput.size();
+
+    Predictor steadyPredictor = CreatePredictor(steadyOperation, steadyHeader);
+    GuessResult guessResult;
+    std::size_t warmAllocations = 0;
+
+    for (std::size_t bitPosition = 0; bitPosition < steadyInput.size() * numberBits; bitPosition++)
+    {
+        if (bitPosition == steadyInput.size() * numberBits / 2)
+        {
+            warmAllocations = allocationCount;
+        }
+
+        const unsigned char bit = GetBitFromInput(steadyInput, bitPosition);
+        MakeGuess(steadyPredictor, bit, guessResult);
+        UpdatePredictor(steadyPredictor, guessResult.guess, bit);
+    }
+
+    assert(allocationCount == warmAllocations);
+}
+
+void TestMemoryBudget()
+{
+    const std::string archiveTarget = "enwik3.memory.iw";
+    const std::string restoredTarget = "enwik3.memory.out";
+    const std::vector<unsigned char> inputBytes = ReadTarget("enwik3");
+
+    Operation operation;
+    operation.command = Command(Action::Compress, "enwik3");
+    operation.command.memory = static_cast<std::uint64_t>(1) << minimumMemoryBits;
+    operation.inputBytes = inputBytes;
+
+    CompressTarget(operation, archiveTarget);
+
+    ByteSource byteSource;
+    OpenSource(byteSource, archiveTarget);
+    const ArchiveHeader archiveHeader = ReadHeader(byteSource, archiveTarget);
+    assert(archiveHeader.memoryBits == minimumMemoryBits);
+
+    ArchiveHeader budgetHeader = archiveHeader;
+    budgetHeader.originalSize = 1 << 24;
+
+    Operation budgetOperation;
+    Predictor budgetPredictor = CreatePredictor(budgetOperation, budgetHeader);
+    assert(budgetPredictor.byteHistory.capacity == static_cast<std::size_t>(1) << (minimumMemoryBits - 2));
+    assert(budgetPredictor.predictionModels.at(Model::Statistics).history.historicData.buckets.size() * bucketSlots == 1 << 14);
+    assert(CreatePredictor(budgetOperation, archiveHeader).predictionModels.at(Model::Statistics).history.historicData.buckets.size() * bucketSlots == 1 << 12);
+    assert(budgetPredictor.probabilityMaps[1].contexts == 1 << 8);
+    assert(budgetPredictor.probabilityMaps[0].cells.size_bytes() + budgetPredictor.probabilityMaps[1].cells.size_bytes() +
+        budgetPredictor.probabilityMaps[2].cells.size_bytes() <= static_cast<std::size_t>(1) << (minimumMemoryBits - 3));
+    assert(CreatePredictor(budgetOperation, ArchiveHeader()).probabilityMaps[1].contexts == 1 << 16);
+    assert(CreatePredictor(budgetOperation, ArchiveHeader()).probabilityMaps[2].contexts == 17 << 8);
+
+    operation.command = Command(Action::Decompress, archiveTarget);
+    operation.inputBytes = {};
+
+    DecompressTarget(operation, restoredTarget);
+    assert(ReadTarget(restoredTarget) == inputBytes);
+
+    std::remove(archiveTarget.c_str());
+    std::remove(restoredTarget.c_str());
+}
+
+void TestBlockContainer()
+{
+    const std::string blockTarget = "enwik3.blocks.iw";
+    const std::string restoredTarget = "enwik3.blocks.out";
+    const std::vector<unsigned char> inputBytes = ReadTarget("enwik3");
+
+    Operation operation;
+    operation.command = Command(Action::Compress, "enwik3");
+    operation.command.jobs = 3;
+    operation.command.blockSize = 96;
+    operation.inputBytes = inputBytes;
+
+    const CodingReport encodeReport = CompressTarget(operation, blockTarget);
+    assert(encodeReport.inputSize == inputBytes.size());
+    assert(ArchiveVersion(blockTarget) == ContainerHeader().version);
+
+    operation.command = Command(Action::Decompress, blockTarget);
+    operation.command.jobs = 2;
+    operation.inputBytes = {};
+
+    const CodingReport decodeReport = DecompressTarget(operation, restoredTarget);
+    assert(decodeReport.outputSize == inputBytes.size());
+    assert(ReadTarget(restoredTarget) == inputBytes);
+
+    std::remove(blockTarget.c_str());
+    std::remove(restoredTarget.c_str());
+}
+
+void TestCorruptArchives()
+{
+    const std::string archiveTarget = "enwik3.corrupt.iw";
+    const std::string restoredTarget = "enwik3.corrupt.out";
+    const std::vector<unsigned char> inputBytes = ReadTarget("enwik3");
+
+    for (const std::size_t blockSize: {0, 96})
+    {
+        Operation operation;
+        operation.command = Command(Action::Compress, "enwik3");
+        operation.command.blockSize = blockSize;
+        operation.inputBytes = inputBytes;
+
+        CompressTarget(operation, archiveTarget);
+        const std::vector<unsigned char> archiveBytes = ReadTarget(archiveTarget);
+
+        operation.command = Command(Action::Decompress, archiveTarget);
+        operation.inputBytes = {};
+
+        for (const std::size_t corruptSize: {archiveBytes.size() - 1, archiveBytes.size() / 2, archiveBytes.size() + 1})
+        {
+            bool rejected = false;
+            std::vector<unsigned char> corruptBytes = archiveBytes;
+            corruptBytes.resize(corruptSize, 'z');
+
+            std::ofstream corruptFile(archiveTarget, std::ios::binary | std::ios::trunc);
+            corruptFile.write(reinterpret_cast<const char*>(corruptBytes.data()), static_cast<std::streamsize>(corruptBytes.size()));
+            corruptFile.close();
+
+            try
+            {
+                DecompressTarget(operation, restoredTarget);
+            }
+            catch (const std::runtime_error&)
+            {
+                rejected = true;
+            }
+
+            assert(rejected);
+        }
+    }
+
+    std::remove(archiveTarget.c_str());
+    std::remove(restoredTarget.c_str());
+}
+
+void TestRangeDecompression()
+{
+    const std::string blockTarget = "enwik3.range.iw";
+    const std::string restoredTarget = "enwik3.range.out";
+    const std::vector<unsigned char> inputBytes = ReadTarget("enwik3");
+    const std::vector<ByteRange> ranges{{0, 10}, {90, 20}, {250, 300}, {960, 100}, {1000, 5}, {0, 1000}};
+
+    Operation operation;
+    operation.command = Command(Action::Compress, "enwik3");
+    operation.command.blockSize = 96;
+    operation.inputBytes = inputBytes;
+
+    CompressTarget(operation, blockTarget);
+    assert(ArchiveVersion(blockTarget) == ContainerHeader().version);
+
+    for (const ByteRange& range: ranges)
+    {
+        const std::size_t rangeStart = std::min<std::size_t>(range.start, inputBytes.size());
+        const std::size_t rangeEnd = rangeStart + std::min<std::size_t>(range.length, inputBytes.size() - rangeStart);
+
+        operation.command = Command(Action::Decompress, blockTarget);
+        operation.command.range = range;
+        operation.inputBytes = {};
+
+        const CodingReport decodeReport = DecompressTarget(operation, restoredTarget);
+        assert(decodeReport.outputSize == rangeEnd - rangeStart);
+        assert(ReadTarget(restoredTarget) ==
+            std::vector<unsigned char>(inputBytes.begin() + rangeStart, inputBytes.begin() + rangeEnd));
+    }
+
+    std::remove(blockTarget.c_str());
+    std::remove(restoredTarget.c_str());
+}
+
+void TestPresets()
+{
+    const std::string archiveTarget = "enwik3.preset.iw";
+    const std::string restoredTarget = "enwik3.preset.out";
+    const std::vector<unsigned char> inputBytes = ReadTarget("enwik3");
+
+    static_assert(FullPipeline::Contains(Model::FutureDictionary) && !LeanPipeline::Contains(Model::FutureDictionary));
+    static_assert(FastPipeline::modelList.size() == 2 && !FastPipeline::Contains(Model::HistoricDictionary));
+
+    for (std::size_t preset = 1; preset <= presetCount; preset += 2)
+    {
+        const PresetLevels& presetLevels = PresetFor(preset);
+
+        Operation operation;
+        operation.command = Command(Action::Compress, "enwik3");
+        operation.command.preset = preset;
+        operation.inputBytes = inputBytes;
+
+        const CodingReport encodeReport = CompressTarget(operation, archiveTarget);
+        assert(presetLevels.modelSet == ModelSet::Full || encodeReport.dictionaryEntries == 0);
+
+        ByteSource byteSource;
+        OpenSource(byteSource, archiveTarget);
+        const ArchiveHeader archiveHeader = ReadHeader(byteSource, archiveTarget);
+        assert(archiveHeader.preset == preset);
+
+        const Predictor predictor = CreatePredictor(Operation(), archiveHeader);
+        assert(predictor.predictionModels[Model::HistoricDictionary].active == (presetLevels.modelSet != ModelSet::Fast));
+        assert(predictor.predictionModels[Model::Statistics].levels == presetLevels.statisticsLevels);
+        assert(ModelSeconds(predictor).size() == (presetLevels.modelSet == ModelSet::Full ? 5 : presetLevels.modelSet == ModelSet::Lean ? 4 : 3));
+        assert(predictor.mixer.inputCount >= VotingLevels(presetLevels.statisticsLevels).size() + 3);
+
+        operation.command = Command(Action::Decompress, archiveTarget);
+        operation.inputBytes = {};
+
+        DecompressTarget(operation, restoredTarget);
+        assert(ReadTarget(restoredTarget) == inputBytes);
+    }
+
+    std::remove(archiveTarget.c_str());
+    std::remove(restoredTarget.c_str());
+}
+
+void TestRunPrediction()
+{
+    const std::string archiveTarget = "runs.iw";
+    const std::string restoredTarget = "runs.out";
+    const std::string pattern = "<page><title>Run</title></page>\n";
+    const std::size_t runPreset = 1;
+    std::vector<unsigned char> inputBytes;
+
+    for (std::size_t repeat = 0; repeat < 64; repeat++)
+    {
+        inputBytes.insert(inputBytes.end(), pattern.begin(), pattern.end());
+    }
+
+    inputBytes[1500] ^= 0x10;
+
+    ArchiveHeader runHeader;
+    runHeader.originalSize = inputBytes.size();
+    runHeader.preset = runPreset;
+
+    Predictor predictor = CreatePredictor(Operation(), runHeader);
+    const std::vector<unsigned char> guessedBits;
+    Guess guess;
+
+    for (std::size_t bitPosition = 0; bitPosition < 200 * 8; bitPosition++)
+    {
+        GuessBit<FastPipeline>(predictor, guessedBits, guess);
+        UpdatePredictor<FastPipeline>(predictor, guess, GetBitFromInput(inputBytes, bitPosition));
+    }
+
+    const RunGuess runGuess = GuessBits<FastPipeline>(predictor, inputBytes.size() - 200);
+    assert(runGuess.length == 64);
+    assert(runGuess.bits == InputWord(inputBytes, 200, 64));
+    assert(CheckGuess(runGuess, runGuess.bits) == 64);
+    assert(CheckGuess(runGuess, runGuess.bits ^ (static_cast<std::uint64_t>(1) << 50)) == 13);
+    assert(GuessBits<FastPipeline>(predictor, 3).length == 24);
+    assert(GuessBits<LeanPipeline>(CreatePredictor(Operation(), ArchiveHeader()), 8).length == 0);
+
+    Operation operation;
+    operation.command = Command(Action::Compress, "runs");
+    operation.command.preset = runPreset;
+    operation.command.blockSize = 1024;
+    operation.inputBytes = inputBytes;
+
+    const CodingReport encodeReport = CompressTarget(operation, archiveTarget);
+    assert(encodeReport.outputSize < inputBytes.size() / 8);
+
+    for (const ByteRange& range: {ByteRange(), ByteRange{1490, 20}, ByteRange{1100, 900}})
+    {
+        operation.command = Command(Action::Decompress, archiveTarget);
+        operation.command.range = range;
+        operation.inputBytes = {};
+
+        DecompressTarget(operation, restoredTarget);
+
+        const std::size_t rangeEnd = static_cast<std::size_t>(std::min<std::uint64_t>(range.start + std::min<std::uint64_t>(range.length, inputBytes.size()), inputBytes.size()));
+        assert(ReadTarget(restoredTarget) == std::vector<unsigned char>(inputBytes.begin() + range.start, inputBytes.begin() + rangeEnd));
+    }
+
+    std::remove(archiveTarget.c_str());
+    std::remove(restoredTarget.c_str());
+}
+
+void TestProbabilityMaps()
+{
+    ArchiveHeader archiveHeader;
+    Predictor predictor = CreatePredictor(Operation(), archiveHeader);
+    Guess guess;
+    guess.mixerProbability = 3000;
+
+    const std::int32_t initialProbability = RefineProbability(predictor, {}, guess);
+    assert(std::abs(initialProbability - 3000) < 32);
+    assert(guess.mapCells[1] == guess.mapCells[0]);
+
+    for (std::size_t repeat = 0; repeat < 100; repeat++)
+    {
+        RecordProbabilityMaps(predictor, guess, 0);
+    }
+
+    assert(RefineProbability(predictor, {}, guess) < initialProbability / 2);
+
+    predictor.byteHistory.window.push_back('a');
+    predictor.byteHistory.length = 1;
+    assert(std::abs(RefineProbability(predictor, {}, guess) - initialProbability) < initialProbability / 2);
+
+    assert(MapContext(('a' << 8) | 0x61, 1 << 16) == (('a' << 8) | 0x61));
+    assert(MapContext(('a' << 8) | 0x61, 1 << 10) < 1 << 10);
+    assert((MapContext(('a' << 8) | 0x61, 1 << 10) & 0xFF) == 0x61);
+    assert(MapContextCount(1 << 16, static_cast<std::uint64_t>(1) << 15) == 1 << 8);
+    assert(MapContextCount(1 << 16, static_cast<std::uint64_t>(1) << 20) == 1 << 12);
+    assert(MapContextCount(1 << 16, static_cast<std::uint64_t>(1) << 24) == 1 << 16);
+}
+
+void TestPrefetchToggle()
+{
+    const std::string prefetchedTarget = "enwik3.prefetch.iw";
+    const std::string unprefetchedTarget = "enwik3.noprefetch.iw";
+    const std::vector<unsigned char> inputBytes = ReadTarget("enwik3");
+
+    Operation operation;
+    operation.command = Command(Action::Compress, "enwik3");
+    operation.inputBytes = inputBytes;
+
+    CompressTarget(operation, prefetchedTarget);
+    operation.command.prefetch = false;
+    CompressTarget(operation, unprefetchedTarget);
+
+    assert(!ReadTarget(prefetchedTarget).empty());
+    assert(ReadTarget(prefetchedTarget) == ReadTarget(unprefetchedTarget));
+
+    std::remove(prefetchedTarget.c_str());
+    std::remove(unprefetchedTarget.c_str());
+}
+
+void TestModelThreads()
+{
+    const std::string pattern = "<page><title>Thread</title></page>\n";
+    std::vector<unsigned char> inputBytes = ReadTarget("enwik3");
+
+    for (std::size_t repeat = 0; repeat < 32; repeat++)
+    {
+        inputBytes.insert(inputBytes.end(), pattern.begin(), pattern.end());
+    }
+
+    inputBytes[1500] ^= 0x10;
+
+    for (std::size_t preset: {1, 3, 6, 9})
+    {
+        std::vector<unsigned char> singleOutput;
+
+        for (std::size_t modelThreads = 1; modelThreads <= 4; modelThreads++)
+        {
+            Operation operation;
+            operation.command = Command(Action::Compress, "threads");
+            operation.command.preset = preset;
+            operation.command.modelThreads = modelThreads;
+            operation.inputBytes = inputBytes;
+
+            std::vector<unsigned char> output;
+            ByteSink byteSink;
+            byteSink.memory = &output;
+
+            CompressStream(operation, byteSink);
+
+            if (modelThreads == 1)
+            {
+                singleOutput = output;
+            }
+
+            assert(!output.empty());
+            assert(output == singleOutput);
+        }
+    }
+
+    const std::vector<std::size_t> availableCores = AvailableCores();
+    std::vector<std::thread> idleWorkers;
+
+    for (std::size_t worker = 0; worker < availableCores.size(); worker++)
+    {
+        idleWorkers.emplace_back([]() {});
+    }
+
+    assert(!PinModelThreads(idleWorkers, availableCores));
+
+    for (std::thread& idleWorker: idleWorkers)
+    {
+        idleWorker.join();
+    }
+}
+
+void TestSnapshots()
+{
+    const std::string snapshotTarget = "enwik3.test.iws";
+    const std::string archiveTarget = "enwik2.snapshot.iw";
+    const std::string restoredTarget = "enwik2.snapshot.out";
+    const std::vector<unsigned char> learnBytes = ReadTarget("enwik3");
+    const std::vector<unsigned char> inputBytes = ReadTarget("enwik2");
+
+    Operation learnOperation;
+    learnOperation.command = Command(Action::Learn, "enwik3");
+    learnOperation.inputBytes = learnBytes;
+    assert(LearnTarget(learnOperation, snapshotTarget).outputSize == std::filesystem::file_size(snapshotTarget));
+
+    const std::shared_ptr<InputBuffer> snapshot = OpenSnapshot(snapshotTarget);
+    assert(SnapshotHeaderOf(*snapshot).identity != 0);
+    assert(SnapshotHeaderOf(*snapshot).preset == defaultPreset);
+    assert(SnapshotHeaderOf(*snapshot).models[Model::Statistics].table.offset % alignof(ContextBucket) == 0);
+
+    Operation operation;
+    operation.command = Command(Action::Compress, "enwik2");
+    operation.inputBytes = inputBytes;
+
+    std::vector<unsigned char> coldOutput;
+    ByteSink coldSink;
+    coldSink.memory = &coldOutput;
+    CompressStream(operation, coldSink);
+
+    ByteSink discardSink;
+    discardSink.discard = true;
+    assert(CompressStream(operation, discardSink).outputSize == coldOutput.size());
+
+    operation.command.snapshot = snapshotTarget;
+    const CodingReport primedReport = CompressTarget(operation, archiveTarget);
+    assert(primedReport.outputSize < coldOutput.size());
+
+    std::vector<unsigned char> conflictOutput;
+    ByteSink conflictSink;
+    conflictSink.memory = &conflictOutput;
+    Operation conflictOperation = operation;
+    conflictOperation.command.explicitPreset = true;
+    assert(CompressStream(conflictOperation, conflictSink).outputSize == primedReport.outputSize);
+
+    for (const bool conflictMemory: {false, true})
+    {
+        bool conflicted = false;
+        conflictOperation.command = operation.command;
+        conflictOperation.command.explicitMemory = conflictMemory;
+        conflictOperation.command.memory = conflictMemory ? operation.command.memory / 2 : operation.command.memory;
+        conflictOperation.command.explicitPreset = !conflictMemory;
+        conflictOperation.command.preset = conflictMemory ? operation.command.preset : 1;
+
+        try
+        {
+            CompressStream(conflictOperation, conflictSink);
+        }
+        catch (const std::runtime_error&)
+        {
+            conflicted = true;
+        }
+
+        assert(conflicted);
+    }
+
+    for (std::size_t modelThreads = 2; modelThreads <= 3; modelThreads++)
+    {
+        std::vector<unsigned char> threadedOutput;
+        ByteSink threadedSink;
+        threadedSink.memory = &threadedOutput;
+
+        operation.command.modelThreads = modelThreads;
+        CompressStream(operation, threadedSink);
+        assert(threadedOutput == ReadTarget(archiveTarget));
+    }
+
+    Operation decodeOperation;
+    decodeOperation.command = Command(Action::Decompress, archiveTarget);
+    decodeOperation.command.snapshot = snapshotTarget;
+    DecompressTarget(decodeOperation, restoredTarget);
+    assert(ReadTarget(restoredTarget) == inputBytes);
+
+    bool rejected = false;
+    decodeOperation.command.snapshot.clear();
+
+    try
+    {
+        DecompressTarget(decodeOperation, restoredTarget);
+    }
+    catch (const std::runtime_error&)
+    {
+        rejected = true;
+    }
+
+    assert(rejected);
+
+    std::remove(snapshotTarget.c_str());
+    std::remove(archiveTarget.c_str());
+    std::remove(restoredTarget.c_str());
+}
+
+#endif
+
+#ifdef COMPRESSOR_BENCHMARK
+double NanosecondsPerBit(std::chrono::steady_clock::duration duration, std::size_t bits)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) /
+        static_cast<double>(bits == 0 ? 1 : bits);
+}
+
+void BenchmarkBitHistory(const std::string& target, const std::vector<unsigned char>& inputBytes)
+{
+    const std::vector<std::size_t> levels{1, 8, 16, 28};
+    const std::size_t inputBits = inputBytes.size() * 8;
+
+    for (std::size_t level: levels)
+    {
+        std::uint64_t walkChecksum = 0;
+        std::uint64_t registerChecksum = 0;
+
+        std::chrono::steady_clock::time_point walkStart = std::chrono::steady_clock::now();
+
+        for (std::size_t bitPosition = level; bitPosition < inputBits; bitPosition++)
+        {
+            walkChecksum += WalkHistoricKey(inputBytes, bitPosition, level);
+        }
+
+        std::chrono::steady_clock::duration walkTime = std::chrono::steady_clock::now() - walkStart;
+        std::chrono::steady_clock::time_point registerStart = std::chrono::steady_clock::now();
+
+        BitHistory bitHistory;
+
+        for (std::size_t bitPosition = 0; bitPosition < inputBits; bitPosition++)
+        {
+            if (bitPosition >= level)
+            {
+                registerChecksum += bitHistory.recentBits & LowMask(level);
+            }
+
+            PushBit(bitHistory, GetBitFromInput(inputBytes, bitPosition));
+        }
+
+        std::chrono::steady_clock::duration registerTime = std::chrono::steady_clock::now() - registerStart;
+
+        if (walkChecksum != registerChecksum)
+        {
+            throw std::runtime_error("Bit history register disagrees with input walk on " + target);
+        }
+
+        std::cout << target << " level " << level << ": walk " << NanosecondsPerBit(walkTime, inputBits)
+                  << " ns/bit, register " << NanosecondsPerBit(registerTime, inputBits) << " ns/bit" << std::endl;
+    }
+}
+
+double MegabytesPerSecond(double seconds, std::size_t bytes)
+{
+    return static_cast<double>(bytes) / 1000000.0 / (seconds == 0.0 ? 1e-9 : seconds);
+}
+
+std::size_t PeakResidentKilobytes()
+{
+    std::ifstream statusFile("/proc/self/status");
+    std::string line;
+    const std::string peakField = "VmHWM:";
+
+    while (std::getline(statusFile, line))
+    {
+        if (line.starts_with(peakField))
+        {
+            return std::stoull(line.substr(peakField.size()));
+        }
+    }
+
+    return 0;
+}
+
+void ResetPeakResident()
+{
+    std::ofstream clearFile("/proc/self/clear_refs");
+    clearFile << "5";
+}
+
+struct BenchmarkOptions
+{
+    std::size_t repeats = 1;
+    std::size_t jobs = 1;
+    std::size_t blockSize = 1 << 24;
+    bool bitHistory = false;
+    bool prefetch = false;
+    bool presets = false;
+    std::size_t threads = 1;
+    std::string jsonTarget;
+    std::vector<std::string> corpus{"enwik", "enwik1", "enwik2", "enwik3"};
+};
+
+struct PresetPoint
+{
+    std::size_t preset = defaultPreset;
+    std::size_t outputSize = 0;
+    double encodeSeconds = 0.0;
+    double decodeSeconds = 0.0;
+};
+
+struct ThreadPoint
+{
+    std::size_t threads = 1;
+    std::size_t cores = 1;
+    double encodeSeconds = 0.0;
+};
+
+struct BenchmarkRun
+{
+    std::string target;
+    std::size_t inputSize = 0;
+    std::size_t outputSize = 0;
+    std::size_t dictionaryEntries = 0;
+    double dictionarySeconds = 0.0;
+    std::vector<double> encodeSeconds;
+    std::vector<double> decodeSeconds;
+    std::size_t encodePeakKilobytes = 0;
+    std::size_t decodePeakKilobytes = 0;
+    std::vector<std::pair<std::string, double>> modelSeconds;
+    std::size_t jobs = 1;
+    std::size_t blockSize = 0;
+    std::size_t blockedOutputSize = 0;
+    std::vector<double> blockedEncodeSeconds;
+    std::vector<double> blockedDecodeSeconds;
+    bool prefetch = false;
+    std::vector<double> unprefetchedEncodeSeconds;
+    std::vector<double> unprefetchedDecodeSeconds;
+    std::vector<PresetPoint> presetCurve;
+    std::vector<ThreadPoint> threadCurve;
+};
+
+struct RoundTrip
+{
+    CodingReport encodeReport;
+    double encodeSeconds = 0.0;
+    double decodeSeconds = 0.0;
+    std::size_t encodePeakKilobytes = 0;
+    std::size_t decodePeakKilobytes = 0;
+};
+
+BenchmarkOptions GetBenchmarkOptions(const std::vector<std::string>& cliArguments)
+{
+    BenchmarkOptions benchmarkOptions;
+    std::vector<std::string> corpus;
+
+    for (std::size_t index = 1; index < cliArguments.size(); index++)
+    {
+        const std::string& argument = cliArguments[index];
+
+        if (argument == "--repeat" && index + 1 < cliArguments.size())
+        {
+            benchmarkOptions.repeats = std::max<std::size_t>(1, std::stoull(cliArguments[++index]));
+        }
+        else if (argument == "--jobs" && index + 1 < cliArguments.size())
+        {
+            benchmarkOptions.jobs = std::max<std::size_t>(1, std::stoull(cliArguments[++index]));
+        }
+        else if (argument == "--block-size" && index + 1 < cliArguments.size())
+        {
+            benchmarkOptions.blockSize = std::max<std::size_t>(1, std::stoull(cliArguments[++index]));
+        }
+        else if (argument == "--json" && index + 1 < cliArguments.size())
+        {
+            benchmarkOptions.jsonTarget = cliArguments[++index];
+        }
+        else if (argument == "--bit-history")
+        {
+            benchmarkOptions.bitHistory = true;
+        }
+        else if (argument == "--prefetch")
+        {
+            benchmarkOptions.prefetch = true;
+        }
+        else if (argument == "--presets")
+        {
+            benchmarkOptions.presets = true;
+        }
+        else if (argument == "--threads" && index + 1 < cliArguments.size())
+        {
+            benchmarkOptions.threads = std::max<std::size_t>(1, std::stoull(cliArguments[++index]));
+        }
+        else if (argument.starts_with("--"))
+        {
+            throw std::runtime_error(argument + " is not a valid benchmark option");
+        }
+        else
+        {
+            corpus.push_back(argument);
+        }
+    }
+
+    if (!corpus.empty())
+    {
+        benchmarkOptions.corpus = corpus;
+    }
+
+    return benchmarkOptions;
+}
+
+double Mean(const std::vector<double>& values)
+{
+    double total = 0.0;
+
+    for (double value: values)
+    {
+        total += value;
+    }
+
+    return values.empty() ? 0.0 : total / static_cast<double>(values.size());
+}
+
+double BitsPerByte(const BenchmarkRun& benchmarkRun)
+{
+    const std::size_t numberBits = 8;
+    return static_cast<double>(benchmarkRun.outputSize * numberBits) /
+        static_cast<double>(benchmarkRun.inputSize == 0 ? 1 : benchmarkRun.inputSize);
+}
+
+RoundTrip BenchmarkRoundTrip(const Command& command)
+{
+    const std::string& target = command.target;
+    const std::string archiveTarget = target + ".benchmark.iw";
+    const std::string restoredTarget = target + ".benchmark.out";
+
+    RoundTrip roundTrip;
+    InputBuffer inputBuffer;
+    OpenInput(inputBuffer, target);
+
+    Operation operation;
+    operation.command = command;
+    operation.inputBytes = InputBytes(inputBuffer);
+
+    ResetPeakResident();
+    std::chrono::steady_clock::time_point encodeStart = std::chrono::steady_clock::now();
+    roundTrip.encodeReport = CompressTarget(operation, archiveTarget);
+    roundTrip.encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count();
+    roundTrip.encodePeakKilobytes = PeakResidentKilobytes();
+
+    operation.command.action = Action::Decompress;
+    operation.command.target = archiveTarget;
+    operation.inputBytes = {};
+
+    ResetPeakResident();
+    std::chrono::steady_clock::time_point decodeStart = std::chrono::steady_clock::now();
+    DecompressTarget(operation, restoredTarget);
+    roundTrip.decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+    roundTrip.decodePeakKilobytes = PeakResidentKilobytes();
+
+    InputBuffer restoredBuffer;
+    OpenInput(restoredBuffer, restoredTarget);
+
+    const bool restored = std::ranges::equal(InputBytes(restoredBuffer), InputBytes(inputBuffer));
+    std::remove(archiveTarget.c_str());
+    std::remove(restoredTarget.c_str());
+
+    if (!restored)
+    {
+        throw std::runtime_error("Decompressed " + target + " does not match the original");
+    }
+
+    return roundTrip;
+}
+
+BenchmarkRun BenchmarkCoding(const std::string& target, const BenchmarkOptions& benchmarkOptions)
+{
+    BenchmarkRun benchmarkRun;
+    benchmarkRun.target = target;
+    benchmarkRun.jobs = benchmarkOptions.jobs;
+    benchmarkRun.blockSize = benchmarkOptions.blockSize;
+    benchmarkRun.prefetch = benchmarkOptions.prefetch;
+
+    for (std::size_t repeat = 0; repeat < benchmarkOptions.repeats; repeat++)
+    {
+        const RoundTrip roundTrip = BenchmarkRoundTrip(Command(Action::Compress, target));
+
+        benchmarkRun.encodeSeconds.push_back(roundTrip.encodeSeconds);
+        benchmarkRun.decodeSeconds.push_back(roundTrip.decodeSeconds);
+        benchmarkRun.encodePeakKilobytes = std::max(benchmarkRun.encodePeakKilobytes, roundTrip.encodePeakKilobytes);
+        benchmarkRun.decodePeakKilobytes = std::max(benchmarkRun.decodePeakKilobytes, roundTrip.decodePeakKilobytes);
+        benchmarkRun.inputSize = roundTrip.encodeReport.inputSize;
+        benchmarkRun.outputSize = roundTrip.encodeReport.outputSize;
+        benchmarkRun.dictionaryEntries = roundTrip.encodeReport.dictionaryEntries;
+        benchmarkRun.dictionarySeconds = roundTrip.encodeReport.dictionarySeconds;
+        benchmarkRun.modelSeconds = roundTrip.encodeReport.modelSeconds;
+
+        if (benchmarkOptions.prefetch)
+        {
+            Command unprefetchedCommand(Action::Compress, target);
+            unprefetchedCommand.prefetch = false;
+
+            const RoundTrip unprefetchedTrip = BenchmarkRoundTrip(unprefetchedCommand);
+
+            if (unprefetchedTrip.encodeReport.outputSize != roundTrip.encodeReport.outputSize)
+            {
+                throw std::runtime_error("Prefetching changed the compressed size of " + target);
+            }
+
+            benchmarkRun.unprefetchedEncodeSeconds.push_back(unprefetchedTrip.encodeSeconds);
+            benchmarkRun.unprefetchedDecodeSeconds.push_back(unprefetchedTrip.decodeSeconds);
+        }
+
+        if (benchmarkOptions.jobs > 1)
+        {
+            Command blockedCommand(Action::Compress, target);
+            blockedCommand.jobs = benchmarkOptions.jobs;
+            blockedCommand.blockSize = benchmarkOptions.blockSize;
+
+            const RoundTrip blockedTrip = BenchmarkRoundTrip(blockedCommand);
+
+            benchmarkRun.blockedEncodeSeconds.push_back(blockedTrip.encodeSeconds);
+            benchmarkRun.blockedDecodeSeconds.push_back(blockedTrip.decodeSeconds);
+            benchmarkRun.blockedOutputSize = blockedTrip.encodeReport.outputSize;
+        }
+    }
+
+    for (std::size_t preset = 1; benchmarkOptions.presets && preset <= presetCount; preset++)
+    {
+        Command presetCommand(Action::Compress, target);
+        presetCommand.preset = preset;
+
+        const RoundTrip presetTrip = BenchmarkRoundTrip(presetCommand);
+        benchmarkRun.presetCurve.push_back(
+            PresetPoint{preset, presetTrip.encodeReport.outputSize, presetTrip.encodeSeconds, presetTrip.decodeSeconds});
+    }
+
+    for (std::size_t threads = 1; benchmarkOptions.threads > 1 && threads <= benchmarkOptions.threads; threads++)
+    {
+        Command threadedCommand(Action::Compress, target);
+        threadedCommand.modelThreads = threads;
+
+        const RoundTrip threadedTrip = BenchmarkRoundTrip(threadedCommand);
+
+        if (threadedTrip.encodeReport.outputSize != benchmarkRun.outputSize)
+        {
+            throw std::runtime_error("Model threads changed the compressed size of " + target);
+        }
+
+        benchmarkRun.threadCurve.push_back(
+            ThreadPoint{threads, std::max<std::size_t>(AvailableCores().size(), 1), threadedTrip.encodeSeconds});
+    }
+
+    return benchmarkRun;
+}
+
+double BlockRatioLoss(const BenchmarkRun& benchmarkRun)
+{
+    const double outputSize = static_cast<double>(benchmarkRun.outputSize == 0 ? 1 : benchmarkRun.outputSize);
+    return (static_cast<double>(benchmarkRun.blockedOutputSize) - outputSize) / outputSize * 100.0;
+}
+
+double HiddenLatency(const std::vector<double>& unprefetchedSeconds, const std::vector<double>& prefetchedSeconds)
+{
+    const double unprefetched = Mean(unprefetchedSeconds);
+    return unprefetched == 0.0 ? 0.0 : (unprefetched - Mean(prefetchedSeconds)) / unprefetched * 100.0;
+}
+
+void PrintBenchmarkRun(const BenchmarkRun& benchmarkRun)
+{
+    const double encodeSpeed = MegabytesPerSecond(Mean(benchmarkRun.encodeSeconds), benchmarkRun.inputSize);
+    const double decodeSpeed = MegabytesPerSecond(Mean(benchmarkRun.decodeSeconds), benchmarkRun.inputSize);
+
+    std::cout << benchmarkRun.target << " coding: " << benchmarkRun.inputSize << " -> " << benchmarkRun.outputSize
+              << " bytes, " << BitsPerByte(benchmarkRun) << " bits per byte, encode " << encodeSpeed << " MB/s ("
+              << benchmarkRun.encodePeakKilobytes << " KiB peak), decode " << decodeSpeed << " MB/s ("
+              << benchmarkRun.decodePeakKilobytes << " KiB peak), dictionary " << benchmarkRun.dictionaryEntries
+              << " entries in " << benchmarkRun.dictionarySeconds * 1000.0 << " ms" << std::endl;
+
+    for (const auto& [modelName, seconds]: benchmarkRun.modelSeconds)
+    {
+        std::cout << benchmarkRun.target << " model " << modelName << ": " << seconds * 1000.0 << " ms" << std::endl;
+    }
+
+    if (benchmarkRun.jobs > 1)
+    {
+        std::cout << benchmarkRun.target << " blocks of " << benchmarkRun.blockSize << " bytes on " << benchmarkRun.jobs
+                  << " jobs: " << benchmarkRun.blockedOutputSize << " bytes (" << BlockRatioLoss(benchmarkRun)
+                  << "% larger), encode "
+                  << MegabytesPerSecond(Mean(benchmarkRun.blockedEncodeSeconds), benchmarkRun.inputSize) << " MB/s, decode "
+                  << MegabytesPerSecond(Mean(benchmarkRun.blockedDecodeSeconds), benchmarkRun.inputSize) << " MB/s"
+                  << std::endl;
+    }
+
+    if (benchmarkRun.prefetch)
+    {
+        std::cout << benchmarkRun.target << " without prefetch: encode "
+                  << MegabytesPerSecond(Mean(benchmarkRun.unprefetchedEncodeSeconds), benchmarkRun.inputSize)
+                  << " MB/s, decode "
+                  << MegabytesPerSecond(Mean(benchmarkRun.unprefetchedDecodeSeconds), benchmarkRun.inputSize)
+                  << " MB/s, prefetch hides "
+                  << HiddenLatency(benchmarkRun.unprefetchedEncodeSeconds, benchmarkRun.encodeSeconds) << "% of encode and "
+                  << HiddenLatency(benchmarkRun.unprefetchedDecodeSeconds, benchmarkRun.decodeSeconds) << "% of decode time"
+                  << std::endl;
+    }
+
+    for (const PresetPoint& presetPoint: benchmarkRun.presetCurve)
+    {
+        std::cout << benchmarkRun.target << " preset " << presetPoint.preset << ": " << presetPoint.outputSize << " bytes, "
+                  << static_cast<double>(presetPoint.outputSize * 8) / static_cast<double>(std::max<std::size_t>(benchmarkRun.inputSize, 1))
+                  << " bits per byte, encode " << MegabytesPerSecond(presetPoint.encodeSeconds, benchmarkRun.inputSize)
+                  << " MB/s, decode " << MegabytesPerSecond(presetPoint.decodeSeconds, benchmarkRun.inputSize) << " MB/s"
+                  << std::endl;
+    }
+
+    for (const ThreadPoint& threadPoint: benchmarkRun.threadCurve)
+    {
+        std::cout << benchmarkRun.target << " model threads " << threadPoint.threads << ": encode "
+                  << MegabytesPerSecond(threadPoint.encodeSeconds, benchmarkRun.inputSize) << " MB/s, ";
+
+        if (threadPoint.cores < threadPoint.threads)
+        {
+            std::cout << "scaling unavailable, only " << threadPoint.cores << " CPU available to " << threadPoint.threads
+                      << " threads" << std::endl;
+            continue;
+        }
+
+        std::cout << benchmarkRun.threadCurve.front().encodeSeconds / std::max(threadPoint.encodeSeconds, 1e-9)
+                  << "x the single thread" << std::endl;
+    }
+}
+
+std::string JsonString(const std::string& text)
+{
+    std::string escaped = "\"";
+
+    for (char character: text)
+    {
+        if (character == '"' || character == '\\')
+        {
+            escaped += '\\';
+        }
+
+        escaped += character;
+    }
+
+    return escaped + "\"";
+}
+
+std::string JsonArray(const std::vector<double>& values)
+{
+    std::string array = "[";
+
+    for (std::size_t index = 0; index < values.size(); index++)
+    {
+        array += (index == 0 ? "" : ", ") + std::to_string(values[index]);
+    }
+
+    return array + "]";
+}
+
+void WriteBenchmarkJson(const std::string& jsonTarget, const std::vector<BenchmarkRun>& benchmarkRuns)
+{
+    std::ofstream jsonFile(jsonTarget, std::ios::trunc);
+
+    if (jsonFile.fail())
+    {
+        throw std::runtime_error("Could not write to file " + jsonTarget);
+    }
+
+    jsonFile << "{\n  \"runs\": [";
+
+    for (std::size_t index = 0; index < benchmarkRuns.size(); index++)
+    {
+        const BenchmarkRun& benchmarkRun = benchmarkRuns[index];
+
+        jsonFile << (index == 0 ? "\n" : ",\n") << "    {\n"
+                 << "      \"target\": " << JsonString(benchmarkRun.target) << ",\n"
+                 << "      \"input_bytes\": " << benchmarkRun.inputSize << ",\n"
+                 << "      \"output_bytes\": " << benchmarkRun.outputSize << ",\n"
+                 << "      \"bits_per_byte\": " << BitsPerByte(benchmarkRun) << ",\n"
+                 << "      \"encode_mb_per_second\": "
+                 << MegabytesPerSecond(Mean(benchmarkRun.encodeSeconds), benchmarkRun.inputSize) << ",\n"
+                 << "      \"decode_mb_per_second\": "
+                 << MegabytesPerSecond(Mean(benchmarkRun.decodeSeconds), benchmarkRun.inputSize) << ",\n"
+                 << "      \"encode_seconds\": " << JsonArray(benchmarkRun.encodeSeconds) << ",\n"
+                 << "      \"decode_seconds\": " << JsonArray(benchmarkRun.decodeSeconds) << ",\n"
+                 << "      \"encode_peak_rss_kib\": " << benchmarkRun.encodePeakKilobytes << ",\n"
+                 << "      \"decode_peak_rss_kib\": " << benchmarkRun.decodePeakKilobytes << ",\n"
+                 << "      \"dictionary_entries\": " << benchmarkRun.dictionaryEntries << ",\n"
+                 << "      \"dictionary_seconds\": " << benchmarkRun.dictionarySeconds << ",\n"
+                 << "      \"jobs\": " << benchmarkRun.jobs << ",\n"
+                 << "      \"block_size\": " << benchmarkRun.blockSize << ",\n"
+                 << "      \"blocked_output_bytes\": " << benchmarkRun.blockedOutputSize << ",\n"
+                 << "      \"blocked_ratio_loss_percent\": " << (benchmarkRun.jobs > 1 ? BlockRatioLoss(benchmarkRun) : 0.0) << ",\n"
+                 << "      \"blocked_encode_seconds\": " << JsonArray(benchmarkRun.blockedEncodeSeconds) << ",\n"
+                 << "      \"blocked_decode_seconds\": " << JsonArray(benchmarkRun.blockedDecodeSeconds) << ",\n"
+                 << "      \"unprefetched_encode_seconds\": " << JsonArray(benchmarkRun.unprefetchedEncodeSeconds) << ",\n"
+                 << "      \"unprefetched_decode_seconds\": " << JsonArray(benchmarkRun.unprefetchedDecodeSeconds) << ",\n"
+                 << "      \"prefetch_hidden_encode_percent\": "
+                 << (benchmarkRun.prefetch ? HiddenLatency(benchmarkRun.unprefetchedEncodeSeconds, benchmarkRun.encodeSeconds) : 0.0) << ",\n"
+                 << "      \"prefetch_hidden_decode_percent\": "
+                 << (benchmarkRun.prefetch ? HiddenLatency(benchmarkRun.unprefetchedDecodeSeconds, benchmarkRun.decodeSeconds) : 0.0) << ",\n"
+                 << "      \"preset_curve\": [";
+
+        for (std::size_t point = 0; point < benchmarkRun.presetCurve.size(); point++)
+        {
+            const PresetPoint& presetPoint = benchmarkRun.presetCurve[point];
+
+            jsonFile << (point == 0 ? "" : ", ") << "{\"preset\": " << presetPoint.preset << ", \"output_bytes\": "
+                     << presetPoint.outputSize << ", \"encode_seconds\": " << presetPoint.encodeSeconds
+                     << ", \"decode_seconds\": " << presetPoint.decodeSeconds << "}";
+        }
+
+        jsonFile << "],\n"
+                 << "      \"thread_curve\": [";
+
+        for (std::size_t point = 0; point < benchmarkRun.threadCurve.size(); point++)
+        {
+            const ThreadPoint& threadPoint = benchmarkRun.threadCurve[point];
+
+            jsonFile << (point == 0 ? "" : ", ") << "{\"threads\": " << threadPoint.threads << ", \"cores\": "
+                     << threadPoint.cores << ", \"encode_seconds\": " << threadPoint.encodeSeconds << "}";
+        }
+
+        jsonFile << "],\n"
+                 << "      \"model_seconds\": {";
+
+        for (std::size_t model = 0; model < benchmarkRun.modelSeconds.size(); model++)
+        {
+            jsonFile << (model == 0 ? "" : ", ") << JsonString(benchmarkRun.modelSeconds[model].first) << ": "
+                     << benchmarkRun.modelSeconds[model].second;
+        }
+
+        jsonFile << "}\n    }";
+    }
+
+    jsonFile << "\n  ]\n}\n";
+}
+#endif
+
+#if defined(COMPRESSOR_TEST)
+int main()
+{
+    try
+    {
+        TestBitInput();
+        TestContextKeys();
+        TestHistoricKeys();
+        TestBitStates();
+        TestModelVotes();
+        TestCommands();
+        TestFixtures();
+        TestMatchModel();
+        TestFutureDictionary();
+        TestSteadyStateAllocations();
+        TestMemoryBudget();
+        TestBlockContainer();
+        TestCorruptArchives();
+        TestRangeDecompression();
+        TestPresets();
+        TestRunPrediction();
+        TestProbabilityMaps();
+        TestPrefetchToggle();
+        TestModelThreads();
+        TestSnapshots();
+
+        std::cout << "All tests passed" << std::endl;
+
+        return 0;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cout << "Something went wrong: " << exception.what() << std::endl;
+        return 1;
+    }
+}
+#elif defined(COMPRESSOR_BENCHMARK)
+int main(int argc, char* argv[])
+{
+    try
+    {
+        std::vector<std::string> cliArguments;
+        cliArguments.assign(argv, argv + argc);
+        const BenchmarkOptions benchmarkOptions = GetBenchmarkOptions(cliArguments);
+        std::vector<BenchmarkRun> benchmarkRuns;
+
+        for (const std::string& target: benchmarkOptions.corpus)
+        {
+            if (benchmarkOptions.bitHistory)
+            {
+                BenchmarkBitHistory(target, ReadTarget(target));
+            }
+
+            benchmarkRuns.push_back(BenchmarkCoding(target, benchmarkOptions));
+            PrintBenchmarkRun(benchmarkRuns.back());
+        }
+
+        if (!benchmarkOptions.jsonTarget.empty())
+        {
+            WriteBenchmarkJson(benchmarkOptions.jsonTarget, benchmarkRuns);
+        }
+
+        return 0;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cout << "Something went wrong: " << exception.what() << std::endl;
+        return 1;
+    }
+}
+#else
+int main(int argc, char* argv[])
+{
     try
     {
         std::vector<std::string> cliArguments;
@@ -823,3 +5984,4 @@ int main(int argc, char* argv[])
         return 1;
     }
 }
+#endif